@@ -0,0 +1,200 @@
+// Filling with zeros in parallel and transporting failures with exception_ptr
+//
+#include <boost/exception/all.hpp>
+#include <boost/exception_ptr.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_chunk_index, std::size_t> chunk_index_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+struct fill_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "fill failed";
+	}
+};
+
+const std::size_t page_size = 4096;
+
+struct worker_report
+{
+	std::size_t bytes = 0;
+	double seconds = 0;
+};
+
+std::vector<worker_report> parallel_fill(char* c, std::size_t size,
+	const std::function<void(char*, std::size_t, std::size_t)>& fill,
+	std::size_t thread_count = std::thread::hardware_concurrency())
+{
+	thread_count = std::max<std::size_t>(1, thread_count);
+	std::size_t chunk = size / (thread_count * 8);
+	chunk = std::max(page_size, (chunk + page_size - 1) & ~(page_size - 1));
+	std::size_t chunk_count = (size + chunk - 1) / chunk;
+
+	std::atomic<std::size_t> next(0);
+	std::atomic<bool> failed(false);
+	boost::exception_ptr failure;
+	std::vector<worker_report> reports(thread_count);
+
+	auto work = [&](std::size_t t) {
+		auto start = std::chrono::steady_clock::now();
+		std::size_t index = 0;
+		try
+		{
+			while (!failed && (index = next++) < chunk_count)
+			{
+				std::size_t begin = index * chunk;
+				std::size_t n = std::min(chunk, size - begin);
+				fill(c + begin, n, index);
+				reports[t].bytes += n;
+			}
+		}
+		catch(boost::exception& e)
+		{
+			e << chunk_index_info(index);
+			if (!failed.exchange(true))
+				failure = boost::current_exception();
+		}
+		catch(...)
+		{
+			if (!failed.exchange(true))
+				failure = boost::current_exception();
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		reports[t].seconds = elapsed.count();
+	};
+
+	std::vector<std::thread> threads;
+	for (std::size_t t = 1; t < thread_count; ++t)
+		threads.emplace_back(work, t);
+	work(0);
+	for (std::thread& t : threads)
+		t.join();
+
+	if (failure)
+		boost::rethrow_exception(failure);
+
+	return reports;
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::align_val_t(page_size), std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+void release_memory(char* c)
+{
+	::operator delete[](c, std::align_val_t(page_size));
+}
+
+char* write_lots_of_zeros(std::size_t size,
+	const std::function<void(char*, std::size_t, std::size_t)>& fill)
+{
+	try
+	{
+		char* c = allocate_memory(size);
+		try
+		{
+			std::vector<worker_report> reports = parallel_fill(c, size, fill);
+			for (std::size_t t = 0; t < reports.size(); ++t)
+				std::cout << "thread " << t << ": "
+					<< reports[t].bytes / reports[t].seconds / 1e9 << " GB/s\n";
+		}
+		catch(...)
+		{
+			release_memory(c);
+			throw;
+		}
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+int main()
+{
+	auto fill = [](char* c, std::size_t n, std::size_t) {
+		std::fill_n(c, n, 0);
+	};
+
+	try
+	{
+		char* c = write_lots_of_zeros(std::size_t(1) << 30, fill);
+		release_memory(c);
+
+		c = write_lots_of_zeros(std::size_t(1) << 30,
+			[&](char* p, std::size_t n, std::size_t index) {
+				if (index == 3)
+					BOOST_THROW_EXCEPTION(fill_failed{});
+				fill(p, n, index);
+			});
+		release_memory(c);
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * A single thread can't saturate the memory bandwidth of a large machine. The above
+ * example splits the buffer into chunks and fills them from several threads.
+ *
+ * parallel_fill() rounds the chunk size to a multiple of the page size and creates
+ * about eight chunks per thread. allocate_memory() uses the aligned form of new
+ * with std::align_val_t, so the buffer starts at a page boundary and every chunk
+ * covers whole pages. No two threads ever write to the same page. Memory from the
+ * aligned new must be released with the matching aligned operator delete[], which
+ * release_memory() calls. The threads don't get fixed ranges. Each one takes the
+ * next chunk index from an atomic counter until all chunks are done, so threads
+ * that run faster simply process more chunks. The calling thread takes part as
+ * worker 0.
+ *
+ * An exception thrown in a worker can't propagate across the thread boundary by
+ * itself. The worker catches it, adds the index of the failing chunk as
+ * chunk_index_info and stores it with boost::current_exception() in a
+ * boost::exception_ptr. The first failure also tells the other workers to stop.
+ * After all threads have been joined, boost::rethrow_exception() throws the stored
+ * exception again in the calling thread, where write_lots_of_zeros() adds
+ * errmsg_info as usual.
+ *
+ * boost::current_exception() can only copy exceptions that were thrown with
+ * BOOST_THROW_EXCEPTION or boost::enable_current_exception(). For other types it
+ * returns an exception_ptr to boost::unknown_exception.
+ *
+ * Each worker reports how many bytes it wrote and how long it ran, so main() can
+ * print the bandwidth per thread. The second call in main() simulates a failure in
+ * chunk 3 to show the exception arriving in the calling thread with the chunk
+ * index attached.
+ *
+ */
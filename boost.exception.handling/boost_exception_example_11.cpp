@@ -0,0 +1,197 @@
+// Zero-filled buffers without writing zeros
+//
+#include <boost/exception/all.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <utility>
+#include <cerrno>
+#include <cstddef>
+#include <iostream>
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+class zero_buffer
+{
+public:
+	explicit zero_buffer(std::size_t size)
+		: size_(size)
+	{
+		void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED)
+		{
+			int err = errno;
+			BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+				boost::errinfo_errno(err));
+		}
+		data_ = static_cast<char*>(p);
+	}
+
+	zero_buffer(zero_buffer&& other) noexcept
+		: data_(std::exchange(other.data_, nullptr)), size_(other.size_)
+	{
+	}
+
+	zero_buffer& operator=(zero_buffer&& other) noexcept
+	{
+		std::swap(data_, other.data_);
+		std::swap(size_, other.size_);
+		return *this;
+	}
+
+	~zero_buffer()
+	{
+		if (data_)
+			munmap(data_, size_);
+	}
+
+	void reset()
+	{
+		madvise(data_, size_, MADV_DONTNEED);
+	}
+
+	char* data() const { return data_; }
+	std::size_t size() const { return size_; }
+
+private:
+	char* data_;
+	std::size_t size_;
+};
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros(std::size_t size)
+{
+	try
+	{
+		char* c = allocate_memory(size);
+		std::fill_n(c, size, 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+zero_buffer get_lots_of_zeros(std::size_t size)
+{
+	try
+	{
+		return zero_buffer(size);
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("getting lots of zeros failed");
+		throw;
+	}
+}
+
+std::size_t resident_bytes()
+{
+	std::size_t pages = 0, resident = 0;
+	std::ifstream statm("/proc/self/statm");
+	statm >> pages >> resident;
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+template <typename F>
+void measure(const char* name, F f)
+{
+	long long before = resident_bytes();
+	auto start = std::chrono::steady_clock::now();
+	f();
+	std::chrono::duration<double, std::micro> elapsed =
+		std::chrono::steady_clock::now() - start;
+	long long after = resident_bytes();
+	std::cout << name << ": " << elapsed.count() << " us, RSS change "
+		<< (after - before) / 1024 << " KiB\n";
+}
+
+void compare_zero_buffers()
+{
+	const std::size_t size = 256 * 1024 * 1024;
+	char* eager = nullptr;
+
+	measure("allocate then fill", [&] { eager = write_lots_of_zeros(size); });
+	delete[] eager;
+
+	zero_buffer lazy = get_lots_of_zeros(1);
+	measure("anonymous mmap", [&] { lazy = get_lots_of_zeros(size); });
+	measure("read every page", [&] {
+		volatile char sink = 0;
+		for (std::size_t i = 0; i < size; i += 4096)
+			sink = sink + lazy.data()[i];
+	});
+	measure("write every page", [&] {
+		for (std::size_t i = 0; i < size; i += 4096)
+			lazy.data()[i] = 1;
+	});
+	measure("madvise(MADV_DONTNEED)", [&] { lazy.reset(); });
+	std::cout << "first byte after reset: " << int(lazy.data()[0]) << '\n';
+}
+
+int main()
+{
+	compare_zero_buffers();
+
+	try
+	{
+		zero_buffer b = get_lots_of_zeros(std::numeric_limits<std::size_t>::max());
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * write_lots_of_zeros() writes every byte of the buffer, even if most of it is
+ * never read. The operating system already hands out zeroed memory: a page of an
+ * anonymous mapping is filled with zeros by the kernel the first time it is
+ * touched. Pages that are only read are mapped to a shared zero page and don't
+ * occupy any memory at all.
+ *
+ * The class zero_buffer obtains its memory with mmap() and MAP_ANONYMOUS, so no
+ * explicit fill is required. If the mapping fails, allocation_failed is thrown with
+ * boost::errinfo_errno attached. get_lots_of_zeros() plays the role of
+ * write_lots_of_zeros() and adds errmsg_info in the same way.
+ *
+ * A buffer that has been written to can be recycled with reset(). madvise() with
+ * MADV_DONTNEED discards the pages of a private anonymous mapping. The next access
+ * sees zeros again, and the memory is returned to the system immediately, which
+ * is cheaper than writing zeros over the whole buffer.
+ *
+ * compare_zero_buffers() prints the time and the change of the resident set size
+ * for each step. Allocating and filling 256 MiB makes all of it resident right
+ * away. The anonymous mapping returns almost immediately and only grows as pages
+ * are written. The resident set size is read from /proc/self/statm, so this part
+ * of the example is Linux specific.
+ *
+ */
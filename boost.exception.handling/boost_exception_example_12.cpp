@@ -0,0 +1,187 @@
+// Rejecting impossible allocations before they reach the heap
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <sys/resource.h>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_requested_size, std::size_t> requested_size_info;
+typedef
+boost::error_info<struct tag_allocation_ceiling, std::size_t> allocation_ceiling_info;
+typedef
+boost::error_info<struct tag_ceiling_source, std::string> ceiling_source_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+struct allocation_ceiling
+{
+	std::size_t bytes;
+	std::string source;
+
+	void lower(std::size_t limit, const char* name)
+	{
+		if (limit < bytes)
+		{
+			bytes = limit;
+			source = name;
+		}
+	}
+};
+
+std::size_t read_limit(const std::string& path)
+{
+	std::ifstream file(path);
+	std::uint64_t limit;
+	if (file >> limit)
+		return limit;
+	return std::numeric_limits<std::size_t>::max();
+}
+
+std::size_t cgroup_memory_limit()
+{
+	std::ifstream cgroup("/proc/self/cgroup");
+	std::string line;
+	while (std::getline(cgroup, line))
+	{
+		if (line.compare(0, 3, "0::") == 0)
+			return read_limit("/sys/fs/cgroup" + line.substr(3) + "/memory.max");
+
+		std::string::size_type colon = line.find(":memory:");
+		if (colon != std::string::npos)
+			return read_limit("/sys/fs/cgroup/memory" + line.substr(colon + 8) +
+				"/memory.limit_in_bytes");
+	}
+	return std::numeric_limits<std::size_t>::max();
+}
+
+allocation_ceiling compute_allocation_ceiling()
+{
+	allocation_ceiling ceiling{std::numeric_limits<std::size_t>::max(), "none"};
+
+	ceiling.lower(std::numeric_limits<std::ptrdiff_t>::max(), "ptrdiff_t");
+#if defined(__x86_64__) || defined(__aarch64__)
+	ceiling.lower(std::size_t(1) << 47, "address space");
+#endif
+
+	rlimit limit;
+	if (getrlimit(RLIMIT_AS, &limit) == 0 && limit.rlim_cur != RLIM_INFINITY)
+		ceiling.lower(limit.rlim_cur, "RLIMIT_AS");
+
+	ceiling.lower(cgroup_memory_limit(), "cgroup memory limit");
+	return ceiling;
+}
+
+std::atomic<std::size_t>& cached_allocation_ceiling()
+{
+	static std::atomic<std::size_t> bytes(compute_allocation_ceiling().bytes);
+	return bytes;
+}
+
+char* allocate_memory(std::size_t size)
+{
+	if (size > cached_allocation_ceiling().load(std::memory_order_relaxed))
+	{
+		allocation_ceiling ceiling = compute_allocation_ceiling();
+		cached_allocation_ceiling().store(ceiling.bytes, std::memory_order_relaxed);
+		if (size > ceiling.bytes)
+			BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+				requested_size_info(size) <<
+				allocation_ceiling_info(ceiling.bytes) <<
+				ceiling_source_info(ceiling.source));
+	}
+
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+int main()
+{
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * The previous examples only find out that a request is impossible after new has
+ * searched the heap and asked the operating system for memory. The above example
+ * compares the requested size with a ceiling before it calls new at all.
+ *
+ * compute_allocation_ceiling() takes the smallest of the following limits and
+ * remembers which one it was:
+ *
+ * - The largest value of std::ptrdiff_t. No object may be larger, because the
+ *   difference of two pointers into it couldn't be represented.
+ * - The user address space. The example assumes 2^47 bytes, the smallest user
+ *   address space of x86-64 and AArch64 in common configurations. It is a
+ *   conservative assumption: AArch64 with 4-level page tables offers 2^48 bytes,
+ *   and x86-64 with 5-level paging 2^56.
+ * - The soft limit of RLIMIT_AS, if one has been set with setrlimit() or ulimit -v.
+ * - The memory limit of the cgroup the process belongs to. For cgroup v2 this is
+ *   memory.max, for cgroup v1 memory.limit_in_bytes. The value "max" can't be read
+ *   as a number and therefore means no limit.
+ *
+ * Reading the limits takes system calls and file access, so the ceiling is
+ * computed the first time allocate_memory() is called and cached. Requests up to
+ * the cached ceiling are accepted without looking at the limits again. The last
+ * two limits can change while the process runs, though: RLIMIT_AS can be raised
+ * with setrlimit() up to the hard limit, and an administrator can change the limit
+ * of the cgroup. A request above the cached ceiling therefore computes the ceiling
+ * again, stores the new value and is only rejected if it exceeds that as well. If
+ * a limit was lowered instead, the cached ceiling is too high until the next
+ * recomputation, and new fails as it would without the check.
+ *
+ * MemAvailable from /proc/meminfo is deliberately not used. It is a snapshot that
+ * is out of date a moment later, and with overcommit, Linux grants requests larger
+ * than it. A process that started under memory pressure would reject requests for
+ * the rest of its life. The ceiling is meant to reject requests that can't
+ * possibly succeed, not to predict every failure, so allocate_memory() still
+ * checks the result of new.
+ *
+ * A rejected request throws allocation_failed with three error_info values: the
+ * requested size, the ceiling and the name of the limit that determined it. The
+ * last one tells an operator whether to raise a ulimit, a cgroup limit or simply
+ * add memory.
+ *
+ */
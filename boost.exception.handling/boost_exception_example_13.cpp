@@ -0,0 +1,208 @@
+// Enforcing a memory budget per tenant in allocate_memory()
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_tenant, int> tenant_info;
+typedef
+boost::error_info<struct tag_requested_size, std::size_t> requested_size_info;
+typedef
+boost::error_info<struct tag_remaining_budget, std::size_t> remaining_budget_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+struct alignas(64) tenant
+{
+	tenant(int tenant_id, std::size_t tenant_budget)
+		: id(tenant_id), budget(tenant_budget), used(0)
+	{
+	}
+
+	bool try_reserve(std::size_t size)
+	{
+		if (size > budget)
+			return false;
+
+		std::size_t before = used.fetch_add(size, std::memory_order_relaxed);
+		if (before + size <= budget)
+			return true;
+
+		used.fetch_sub(size, std::memory_order_relaxed);
+		return false;
+	}
+
+	void release(std::size_t size)
+	{
+		used.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	std::size_t remaining() const
+	{
+		return budget - std::min(budget, used.load(std::memory_order_relaxed));
+	}
+
+	const int id;
+	const std::size_t budget;
+	std::atomic<std::size_t> used;
+};
+
+char* allocate_memory(tenant& t, std::size_t size)
+{
+	if (!t.try_reserve(size))
+		BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+			tenant_info(t.id) <<
+			requested_size_info(size) <<
+			remaining_budget_info(t.remaining()));
+
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+	{
+		t.release(size);
+		BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+			tenant_info(t.id) <<
+			requested_size_info(size) <<
+			remaining_budget_info(t.remaining()));
+	}
+
+	return c;
+}
+
+void free_memory(tenant& t, char* c, std::size_t size)
+{
+	delete[] c;
+	t.release(size);
+}
+
+char* write_lots_of_zeros(tenant& t)
+{
+	try
+	{
+		char* c = allocate_memory(t, std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+double nanoseconds_per_reservation(std::vector<tenant*> tenants)
+{
+	const std::size_t iterations = 1000000;
+	std::vector<std::thread> threads;
+	std::vector<double> results(tenants.size());
+
+	for (std::size_t i = 0; i < tenants.size(); ++i)
+	{
+		threads.emplace_back([&, i] {
+			tenant& t = *tenants[i];
+			auto start = std::chrono::steady_clock::now();
+			for (std::size_t n = 0; n < iterations; ++n)
+			{
+				if (t.try_reserve(64))
+					t.release(64);
+			}
+			std::chrono::duration<double, std::nano> elapsed =
+				std::chrono::steady_clock::now() - start;
+			results[i] = elapsed.count() / iterations;
+		});
+	}
+	for (std::thread& t : threads)
+		t.join();
+
+	double sum = 0;
+	for (double r : results)
+		sum += r;
+	return sum / results.size();
+}
+
+void measure_accounting()
+{
+	const int thread_count = 32;
+	std::deque<tenant> tenants;
+	for (int id = 0; id <= thread_count; ++id)
+		tenants.emplace_back(id, std::size_t(1) << 30);
+
+	std::vector<tenant*> own, shared;
+	for (int i = 0; i < thread_count; ++i)
+	{
+		own.push_back(&tenants[i]);
+		shared.push_back(&tenants[thread_count]);
+	}
+
+	std::cout << "1 thread: "
+		<< nanoseconds_per_reservation({ &tenants[0] }) << " ns\n"
+		<< thread_count << " threads, one tenant each: "
+		<< nanoseconds_per_reservation(own) << " ns\n"
+		<< thread_count << " threads, one shared tenant: "
+		<< nanoseconds_per_reservation(shared) << " ns\n";
+}
+
+int main()
+{
+	measure_accounting();
+
+	try
+	{
+		tenant t(7, 64 * 1024 * 1024);
+		char* c = allocate_memory(t, 1024);
+		free_memory(t, write_lots_of_zeros(t), std::numeric_limits<std::size_t>::max());
+		free_memory(t, c, 1024);
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * If several tenants share one process, a single tenant must not be able to use up
+ * all memory. In the above example, every call to allocate_memory() is charged to
+ * a tenant, and the request is refused if the tenant would exceed its budget.
+ *
+ * The accounting is lock-free. try_reserve() adds the requested size to the
+ * atomic counter used with a single fetch_add(). If the previous value plus the
+ * request exceeds the budget, the size is subtracted again and the request is
+ * refused. While that happens, other threads may briefly see a counter above the
+ * budget and refuse requests that would have fit, but a tenant can never actually
+ * hold more than its budget. A request larger than the budget is rejected before
+ * the counter is touched, so the addition can't overflow.
+ *
+ * Relaxed memory ordering is sufficient because the counter doesn't protect any
+ * other data. tenant is aligned to 64 bytes, so the counters of different tenants
+ * don't share a cache line.
+ *
+ * A refused request throws allocation_failed with the tenant's id, the requested
+ * size and the budget that was left at that moment. If the budget allows the
+ * request but new fails, the reservation is returned before the exception is
+ * thrown, and the exception carries the same three values.
+ *
+ * measure_accounting() reports the cost of a reservation and a release. With one
+ * tenant per thread the counters stay in each core's cache and the cost is a few
+ * nanoseconds. When 32 threads charge the same tenant, the cache line moves
+ * between cores on every operation, which is the worst case.
+ *
+ */
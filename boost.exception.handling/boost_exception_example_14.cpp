@@ -0,0 +1,230 @@
+// Reporting out-of-memory failures when the heap is exhausted
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <mutex>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+class emergency_pool
+{
+public:
+	void* allocate(std::size_t size)
+	{
+		const std::size_t align = alignof(std::max_align_t);
+		if (size > sizeof(buffer_))
+			return nullptr;
+		size = (size + align - 1) & ~(align - 1);
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (size > sizeof(buffer_) - used_)
+			return nullptr;
+
+		void* p = buffer_ + used_;
+		used_ += size;
+		++live_;
+		++served_;
+		return p;
+	}
+
+	bool deallocate(void* p)
+	{
+		if (p < buffer_ || p >= buffer_ + sizeof(buffer_))
+			return false;
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (--live_ == 0)
+			used_ = 0;
+		return true;
+	}
+
+	std::size_t served() const
+	{
+		return served_;
+	}
+
+private:
+	alignas(std::max_align_t) char buffer_[64 * 1024];
+	std::size_t used_ = 0;
+	std::size_t live_ = 0;
+	std::size_t served_ = 0;
+	std::mutex mutex_;
+};
+
+emergency_pool pool;
+bool inject_malloc_failure = false;
+std::size_t failed_mallocs = 0;
+
+extern "C" void* __libc_malloc(std::size_t size) noexcept;
+
+extern "C" void* malloc(std::size_t size) noexcept
+{
+	if (inject_malloc_failure)
+	{
+		++failed_mallocs;
+		return nullptr;
+	}
+	return __libc_malloc(size);
+}
+
+void* allocate_or_fall_back(std::size_t size) noexcept
+{
+	void* p = std::malloc(size ? size : 1);
+	return p ? p : pool.allocate(size);
+}
+
+void* operator new(std::size_t size)
+{
+	for (;;)
+	{
+		if (void* p = allocate_or_fall_back(size))
+			return p;
+
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch(...)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+	if (!pool.deallocate(p))
+		std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept
+{
+	operator delete(p);
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+int main()
+{
+	inject_malloc_failure = true;
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+	inject_malloc_failure = false;
+
+	std::cerr << "failed calls to malloc(): " << failed_mallocs << '\n'
+		<< "allocations served by the emergency pool: " << pool.served() << '\n';
+}
+
+/*
+ * allocate_memory() throws when memory is exhausted, but throwing needs memory
+ * too. BOOST_THROW_EXCEPTION creates an object of type boost::wrapexcept that is
+ * copied into memory obtained by the C++ runtime. Every error_info added with
+ * operator<< is stored in a map node and a boost::shared_ptr, and the string in
+ * errmsg_info needs its own buffer. All of these come from operator new. If the
+ * heap is really exhausted, the exception might turn into std::bad_alloc on its
+ * way, or the process might terminate.
+ *
+ * The runtime already keeps a small emergency buffer for the exception object
+ * itself. The above example extends the same idea to everything else by replacing
+ * the global operator new and operator delete. Every allocation first goes to
+ * malloc(). Only if malloc() fails is the request served from emergency_pool, a
+ * static 64 KiB buffer reserved when the program starts.
+ *
+ * The pool hands out memory by moving an offset forward. It doesn't free
+ * individual blocks, it only counts them, and it starts over once the last block
+ * has been returned. This is enough for the short burst of allocations needed to
+ * throw, annotate, catch and report one exception. operator delete checks the
+ * address to decide whether a block belongs to the pool or to malloc().
+ *
+ * Like the operator new it replaces, the throwing version calls the installed
+ * new_handler in a loop before it gives up with std::bad_alloc, so the handler
+ * can free memory and let the request be retried. The nothrow versions call the
+ * throwing one and return a null pointer instead of the exception, which is what
+ * the standard prescribes for them. Requests that don't fit, such as the one in
+ * write_lots_of_zeros(), still fail, so new(std::nothrow) keeps returning a null
+ * pointer for them.
+ *
+ * To verify the emergency path, main() sets inject_malloc_failure. The example
+ * replaces malloc() itself, so the failure isn't limited to operator new: the
+ * memory for the exception object, which the C++ runtime requests with malloc()
+ * as well, can't be allocated either, and the runtime falls back to its own
+ * emergency buffer. The replacement forwards to __libc_malloc(), so this part
+ * only works with glibc. The diagnostic printed in main() is nevertheless
+ * complete, including errmsg_info. The last two lines show how many calls to
+ * malloc() failed and how many allocations were served by the pool.
+ *
+ */
@@ -0,0 +1,441 @@
+// Storing error_info inline in the exception object
+//
+#include <boost/exception/all.hpp>
+#include <boost/exception/to_string_stub.hpp>
+#include <boost/core/demangle.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <tuple>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+
+template <class Tag, class T>
+struct inline_info
+{
+	typedef Tag tag_type;
+	typedef T value_type;
+	typedef boost::error_info<Tag, T> fallback_type;
+
+	explicit inline_info(const T& v) : value(v) {}
+
+	T value;
+};
+
+class inline_error_info : public boost::exception
+{
+public:
+	static const std::size_t capacity = 8;
+	static const std::size_t slot_size = 32;
+
+	inline_error_info() = default;
+
+	inline_error_info(const inline_error_info& other)
+		: boost::exception(other)
+	{
+		try
+		{
+			for (; count_ < other.count_; ++count_)
+			{
+				slots_[count_].ops = other.slots_[count_].ops;
+				slots_[count_].ops->copy(slots_[count_].storage, other.slots_[count_].storage);
+			}
+		}
+		catch(...)
+		{
+			for (std::size_t i = 0; i < count_; ++i)
+				slots_[i].ops->destroy(slots_[i].storage);
+			throw;
+		}
+	}
+
+	inline_error_info& operator=(const inline_error_info&) = delete;
+
+	~inline_error_info() noexcept
+	{
+		for (std::size_t i = 0; i < count_; ++i)
+			slots_[i].ops->destroy(slots_[i].storage);
+	}
+
+	template <class Tag, class T>
+	bool set(const T& value) const
+	{
+		if (sizeof(T) > slot_size || alignof(T) > alignof(std::max_align_t))
+			return false;
+
+		const slot_ops* ops = &ops_for<Tag, T>::ops;
+		for (std::size_t i = 0; i < count_; ++i)
+		{
+			if (slots_[i].ops == ops)
+			{
+				*static_cast<T*>(static_cast<void*>(slots_[i].storage)) = value;
+				return true;
+			}
+		}
+
+		if (count_ == capacity)
+			return false;
+
+		new (slots_[count_].storage) T(value);
+		slots_[count_].ops = ops;
+		++count_;
+		return true;
+	}
+
+	template <class Tag, class T>
+	const T* get() const
+	{
+		const slot_ops* ops = &ops_for<Tag, T>::ops;
+		for (std::size_t i = 0; i < count_; ++i)
+		{
+			if (slots_[i].ops == ops)
+				return static_cast<const T*>(static_cast<const void*>(slots_[i].storage));
+		}
+		return nullptr;
+	}
+
+	template <class... Infos>
+	void find(std::tuple<const typename Infos::value_type*...>& result) const
+	{
+		for (std::size_t i = 0; i < count_; ++i)
+			match<Infos...>(slots_[i], result, std::index_sequence_for<Infos...>());
+	}
+
+	std::string inline_values() const
+	{
+		std::string s;
+		for (std::size_t i = 0; i < count_; ++i)
+			s += slots_[i].ops->name_value(slots_[i].storage);
+		return s;
+	}
+
+private:
+	struct slot_ops
+	{
+		void (*copy)(void*, const void*);
+		void (*destroy)(void*);
+		std::string (*name_value)(const void*);
+	};
+
+	template <class Tag, class T>
+	struct ops_for
+	{
+		static void copy(void* to, const void* from)
+		{
+			new (to) T(*static_cast<const T*>(from));
+		}
+
+		static void destroy(void* p)
+		{
+			static_cast<T*>(p)->~T();
+		}
+
+		static std::string name_value(const void* p)
+		{
+			return '[' + boost::core::demangle(typeid(Tag*).name()) + "] = " +
+				boost::to_string_stub(*static_cast<const T*>(p)) + '\n';
+		}
+
+		static const slot_ops ops;
+	};
+
+	struct slot
+	{
+		const slot_ops* ops;
+		alignas(std::max_align_t) unsigned char storage[slot_size];
+	};
+
+	template <class... Infos, class Tuple, std::size_t... I>
+	static void match(const slot& s, Tuple& result, std::index_sequence<I...>)
+	{
+		(void)((s.ops == &ops_for<typename Infos::tag_type, typename Infos::value_type>::ops &&
+			(std::get<I>(result) = static_cast<const typename Infos::value_type*>(
+				static_cast<const void*>(s.storage)))) || ...);
+	}
+
+	mutable slot slots_[capacity];
+	mutable std::size_t count_ = 0;
+};
+
+template <class Tag, class T>
+const inline_error_info::slot_ops inline_error_info::ops_for<Tag, T>::ops = {
+	&ops_for<Tag, T>::copy, &ops_for<Tag, T>::destroy, &ops_for<Tag, T>::name_value
+};
+
+template <class E, class Tag, class T>
+typename std::enable_if<std::is_base_of<inline_error_info, E>::value, const E&>::type
+operator<<(const E& x, const inline_info<Tag, T>& v)
+{
+	if (!x.template set<Tag, T>(v.value))
+		x << boost::error_info<Tag, T>(v.value);
+	return x;
+}
+
+template <class InlineInfo>
+const typename InlineInfo::value_type* get_inline_info(const inline_error_info& e)
+{
+	typedef typename InlineInfo::value_type value_type;
+	if (const value_type* v = e.get<typename InlineInfo::tag_type, value_type>())
+		return v;
+	return boost::get_error_info<typename InlineInfo::fallback_type>(e);
+}
+
+template <class... Infos, std::size_t... I>
+std::tuple<const typename Infos::value_type*...>
+get_inline_infos(const inline_error_info& e, std::index_sequence<I...>)
+{
+	std::tuple<const typename Infos::value_type*...> result;
+	e.find<Infos...>(result);
+	((std::get<I>(result) = std::get<I>(result) ? std::get<I>(result) :
+		boost::get_error_info<typename Infos::fallback_type>(e)), ...);
+	return result;
+}
+
+template <class... Infos>
+std::tuple<const typename Infos::value_type*...>
+get_inline_infos(const inline_error_info& e)
+{
+	return get_inline_infos<Infos...>(e, std::index_sequence_for<Infos...>());
+}
+
+std::string inline_diagnostic_information(const inline_error_info& e)
+{
+	return boost::diagnostic_information(e) + e.inline_values();
+}
+
+typedef
+inline_info<struct tag_errmsg, std::string> errmsg_info;
+
+struct allocation_failed : public inline_error_info, public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(inline_error_info& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+template <int Level>
+struct tag_frame;
+
+template <int Level, template <class, class> class Info>
+void annotated_frame()
+{
+	try
+	{
+		if (Level == 0)
+			BOOST_THROW_EXCEPTION(allocation_failed{});
+		else
+			annotated_frame<(Level > 0 ? Level - 1 : 0), Info>();
+	}
+	catch(allocation_failed& e)
+	{
+		e << Info<tag_frame<Level>, int>(Level);
+		throw;
+	}
+}
+
+template <template <class, class> class Info>
+double nanoseconds_per_annotation()
+{
+	const int iterations = 100000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		allocation_failed e;
+		e << Info<tag_frame<0>, int>(0) << Info<tag_frame<1>, int>(1) <<
+			Info<tag_frame<2>, int>(2) << Info<tag_frame<3>, int>(3);
+		allocation_failed copy(e);
+		asm volatile("" : : "r"(&copy) : "memory");
+	}
+	std::chrono::duration<double, std::nano> elapsed =
+		std::chrono::steady_clock::now() - start;
+	return elapsed.count() / iterations;
+}
+
+template <template <class, class> class Info>
+double nanoseconds_per_throw()
+{
+	const int iterations = 100000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		try
+		{
+			annotated_frame<3, Info>();
+		}
+		catch(allocation_failed&)
+		{
+		}
+	}
+	std::chrono::duration<double, std::nano> elapsed =
+		std::chrono::steady_clock::now() - start;
+	return elapsed.count() / iterations;
+}
+
+template <int I>
+using frame_info = inline_info<tag_frame<I>, int>;
+
+enum class extraction { boost_lookups, inline_lookups, inline_batch };
+
+template <extraction Mode>
+double nanoseconds_per_extraction()
+{
+	allocation_failed e;
+	if (Mode == extraction::boost_lookups)
+	{
+		e << boost::error_info<tag_frame<0>, int>(0) << boost::error_info<tag_frame<1>, int>(1) <<
+			boost::error_info<tag_frame<2>, int>(2) << boost::error_info<tag_frame<3>, int>(3) <<
+			boost::error_info<tag_frame<4>, int>(4) << boost::error_info<tag_frame<5>, int>(5) <<
+			boost::error_info<tag_frame<6>, int>(6) << boost::error_info<tag_frame<7>, int>(7);
+	}
+	else
+	{
+		e << frame_info<0>(0) << frame_info<1>(1) << frame_info<2>(2) << frame_info<3>(3) <<
+			frame_info<4>(4) << frame_info<5>(5) << frame_info<6>(6) << frame_info<7>(7);
+	}
+
+	const int iterations = 1000000;
+	int sum = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		if (Mode == extraction::inline_batch)
+		{
+			auto infos = get_inline_infos<frame_info<0>, frame_info<1>, frame_info<2>,
+				frame_info<3>, frame_info<4>, frame_info<5>, frame_info<6>,
+				frame_info<7>>(e);
+			std::apply([&](auto... p) { sum += (*p + ...); }, infos);
+		}
+		else
+		{
+			sum += *get_inline_info<frame_info<0>>(e) + *get_inline_info<frame_info<1>>(e) +
+				*get_inline_info<frame_info<2>>(e) + *get_inline_info<frame_info<3>>(e) +
+				*get_inline_info<frame_info<4>>(e) + *get_inline_info<frame_info<5>>(e) +
+				*get_inline_info<frame_info<6>>(e) + *get_inline_info<frame_info<7>>(e);
+		}
+		asm volatile("" : "+r"(sum));
+	}
+	std::chrono::duration<double, std::nano> elapsed =
+		std::chrono::steady_clock::now() - start;
+	if (sum != iterations * 28)
+	{
+		std::cerr << "\nbenchmark invalid: extracted values have the wrong sum\n";
+		std::exit(EXIT_FAILURE);
+	}
+	return elapsed.count() / iterations;
+}
+
+int main()
+{
+	std::cout << "annotate and copy, boost::error_info: "
+		<< nanoseconds_per_annotation<boost::error_info>() << " ns\n"
+		<< "annotate and copy, inline_info:       "
+		<< nanoseconds_per_annotation<inline_info>() << " ns\n"
+		<< "annotate and rethrow, boost::error_info: "
+		<< nanoseconds_per_throw<boost::error_info>() << " ns\n"
+		<< "annotate and rethrow, inline_info:       "
+		<< nanoseconds_per_throw<inline_info>() << " ns\n"
+		<< "8 values, boost::get_error_info: "
+		<< nanoseconds_per_extraction<extraction::boost_lookups>() << " ns\n"
+		<< "8 values, get_inline_info:       "
+		<< nanoseconds_per_extraction<extraction::inline_lookups>() << " ns\n"
+		<< "8 values, get_inline_infos:      "
+		<< nanoseconds_per_extraction<extraction::inline_batch>() << " ns\n";
+
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(allocation_failed& e)
+	{
+		std::cerr << inline_diagnostic_information(e)
+			<< "errmsg_info: " << *get_inline_info<errmsg_info>(e) << '\n';
+	}
+}
+
+/*
+ * Every value added to a boost::exception with operator<< is copied into a new
+ * object of type boost::error_info, managed by a boost::shared_ptr and stored in a
+ * std::map that is itself allocated on first use. That is several allocations for
+ * each annotation, and a tree search for each call to boost::get_error_info().
+ *
+ * The above example defines inline_info, a counterpart of boost::error_info, and
+ * the class inline_error_info, which exception types derive from instead of
+ * boost::exception. inline_error_info keeps up to eight values directly in the
+ * exception object. Each slot holds up to 32 bytes and a pointer to a table of
+ * functions that copy, destroy and print the value. There is one such table per
+ * combination of tag and type, so its address identifies the tag. Finding a value
+ * is a linear scan comparing pointers, and no reference counts are involved.
+ *
+ * If all slots are in use, or a value is too large, operator<< falls back to
+ * storing a boost::error_info with the same tag and type in the boost::exception
+ * base. get_inline_info() looks in both places, so callers don't need to know
+ * where a value ended up.
+ *
+ * get_inline_infos() extracts several values at once and returns a std::tuple of
+ * pointers, one per requested type. It walks the inline slots a single time and
+ * compares each slot with all requested tags. Only values that weren't found
+ * inline are looked up in the boost::exception base, and pointers to values that
+ * don't exist at all are null.
+ *
+ * boost::diagnostic_information() only knows about the values stored by
+ * boost::exception. inline_diagnostic_information() appends the inline values in
+ * the same format. It has a different name on purpose: an overload named
+ * diagnostic_information() would lose against the template from namespace boost,
+ * which ADL finds and which matches allocation_failed exactly.
+ *
+ * The inline values are copied along with the exception, which
+ * BOOST_THROW_EXCEPTION does when it wraps allocation_failed. If copying a value
+ * throws, for example a std::string when memory is exhausted, the copy
+ * constructor destroys the values it has already copied before passing the
+ * exception on. The destructor doesn't run for an object whose constructor
+ * failed. The values can't be moved to another slot, so inline_error_info can't be
+ * assigned.
+ *
+ * main() first measures both containers. Adding four int values to an exception
+ * and copying it is about an order of magnitude faster with inline_info. A throw
+ * through four frames that each catch the exception, add an int and rethrow is
+ * dominated by unwinding, so the difference there is much smaller.
+ *
+ * Finally, main() extracts eight int values from an exception. Stored in the
+ * boost::exception base, each value costs a separate search of the map. Stored
+ * inline, eight calls to get_inline_info() are already much faster, and
+ * get_inline_infos() saves the repeated walks over the slots.
+ *
+ * Annotating with std::string, as write_lots_of_zeros() does, still allocates for
+ * strings longer than the small-string buffer of the standard library.
+ *
+ */
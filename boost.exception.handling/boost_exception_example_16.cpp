@@ -0,0 +1,115 @@
+// Error messages that refer to string literals
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string_view>
+#include <limits>
+#include <algorithm>
+#include <cstddef>
+#include <ostream>
+#include <iostream>
+
+class literal
+{
+public:
+	template <std::size_t N>
+	constexpr literal(const char (&s)[N])
+		: s_(s, N - 1)
+	{
+	}
+
+	constexpr std::string_view view() const
+	{
+		return s_;
+	}
+
+private:
+	std::string_view s_;
+};
+
+std::ostream& operator<<(std::ostream& os, literal l)
+{
+	return os << l.view();
+}
+
+typedef
+boost::error_info<struct tag_errmsg, literal> errmsg_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+int main()
+{
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+		std::cerr << boost::get_error_info<errmsg_info>(e)->view() << '\n';
+	}
+}
+
+/*
+ * errmsg_info in the previous examples stores a std::string. Every time the
+ * exception is annotated, the message is copied into a new string, and because
+ * "writing lots of zeros failed" is too long for the small-string buffer of most
+ * standard libraries, that copy allocates memory.
+ *
+ * The message is a string literal, which lives in static storage for the whole
+ * run of the program. It is enough to store a reference to it. The above example
+ * defines errmsg_info with the value type literal, a thin wrapper around
+ * std::string_view. Copying a literal copies a pointer and a length.
+ *
+ * literal can only be constructed from an array of char, and the size is taken
+ * from the array type at compile time. A std::string or a char pointer doesn't
+ * convert to literal, so a temporary string can't end up dangling inside the
+ * exception. An array with automatic storage duration would still be accepted,
+ * so literal should only be used with string literals.
+ *
+ * boost::diagnostic_information() formats values of types that provide an
+ * operator<< for std::ostream. The overload for literal writes the characters of
+ * the string_view, so the output is the same as with std::string:
+ *
+ * 				[tag_errmsg*] = writing lots of zeros failed
+ *
+ * boost::get_error_info() returns a pointer to the stored literal, and view()
+ * gives access to the text.
+ *
+ * The object of type boost::error_info that holds the literal is still allocated
+ * by boost::exception. Only the copy of the text is avoided.
+ *
+ */
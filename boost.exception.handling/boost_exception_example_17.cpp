@@ -0,0 +1,137 @@
+// Tags with names and ids known at compile time
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <string_view>
+#include <limits>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+template <class Tag>
+struct registered_tag;
+
+template <class... Tags>
+struct tag_registry
+{
+	static constexpr bool unique_ids()
+	{
+		const std::uint32_t ids[] = { Tags::id... };
+		for (std::size_t i = 0; i < sizeof...(Tags); ++i)
+			for (std::size_t j = i + 1; j < sizeof...(Tags); ++j)
+				if (ids[i] == ids[j])
+					return false;
+		return true;
+	}
+};
+
+template <class Tag, class T>
+std::string to_string(const boost::error_info<registered_tag<Tag>, T>& x)
+{
+	std::string s;
+	s += '[';
+	s.append(Tag::name);
+	s += "] = ";
+	s += boost::to_string_stub(x.value());
+	s += '\n';
+	return s;
+}
+
+struct tag_errmsg
+{
+	static constexpr std::string_view name = "tag_errmsg";
+	static constexpr std::uint32_t id = 1;
+};
+
+struct tag_requested_size
+{
+	static constexpr std::string_view name = "tag_requested_size";
+	static constexpr std::uint32_t id = 2;
+};
+
+static_assert(tag_registry<tag_errmsg, tag_requested_size>::unique_ids(),
+	"every tag needs its own id");
+
+typedef
+boost::error_info<registered_tag<tag_errmsg>, std::string> errmsg_info;
+typedef
+boost::error_info<registered_tag<tag_requested_size>, std::size_t> requested_size_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+			requested_size_info(size));
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+int main()
+{
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * To print the name of a tag, boost::diagnostic_information() takes the name of
+ * the type from typeid and demangles it at run time. The result differs between
+ * compilers, as the output of Example 56.1 with Visual C++ shows, and it is
+ * computed again for every value.
+ *
+ * In the above example, each tag declares its name and a numeric id as constexpr
+ * members. The name is what diagnostics print. The id is meant for code that
+ * stores or transmits error_info values and needs a key that stays the same
+ * across compilers and builds, such as a serializer. tag_registry checks at
+ * compile time that no two tags use the same id.
+ *
+ * boost::error_info is not used with the tag directly but with registered_tag,
+ * which wraps it. This makes it possible to provide a to_string() overload for all
+ * registered tags. Boost.Exception calls to_string() for an error_info to create
+ * its line in the output of boost::diagnostic_information(). Its own version is a
+ * template over any tag, so the overload for registered_tag is more specialized
+ * and wins. It writes the constexpr name instead of the demangled type name and
+ * doesn't use RTTI for the tag:
+ *
+ * 				[tag_errmsg] = writing lots of zeros failed
+ * 				[tag_requested_size] = 18446744073709551615
+ *
+ * boost::get_error_info() still finds values by comparing std::type_info objects
+ * in the container of boost::exception, which can't be changed from the outside.
+ * The dynamic type of the exception is demangled as before.
+ *
+ */
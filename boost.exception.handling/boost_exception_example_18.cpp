@@ -0,0 +1,124 @@
+// The cost of boost::get_error_info()
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+
+template <int I>
+struct tag_index;
+
+struct allocation_failed : public boost::exception, public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+template <int... I>
+void add_infos(const boost::exception& e, std::integer_sequence<int, I...>)
+{
+	(void)(e << ... << boost::error_info<tag_index<I>, int>(I));
+}
+
+template <int N>
+double nanoseconds_per_lookup()
+{
+	allocation_failed e;
+	add_infos(e, std::make_integer_sequence<int, N>());
+	e << errmsg_info("writing lots of zeros failed");
+	const boost::exception& ce = e;
+
+	const int iterations = 1000000;
+	std::size_t found = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		const std::string* msg = boost::get_error_info<errmsg_info>(ce);
+		asm volatile("" : : "r"(msg) : "memory");
+		found += msg != nullptr;
+	}
+	std::chrono::duration<double, std::nano> elapsed =
+		std::chrono::steady_clock::now() - start;
+	if (found != iterations)
+	{
+		std::cerr << "\nbenchmark invalid: boost::get_error_info() didn't find errmsg_info\n";
+		std::exit(EXIT_FAILURE);
+	}
+	return elapsed.count() / iterations;
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+int main()
+{
+	std::cout << "1 info:   " << nanoseconds_per_lookup<0>() << " ns\n"
+		<< "8 infos:  " << nanoseconds_per_lookup<7>() << " ns\n"
+		<< "64 infos: " << nanoseconds_per_lookup<63>() << " ns\n";
+
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(const boost::exception& e)
+	{
+		if (const std::string* msg = boost::get_error_info<errmsg_info>(e))
+			std::cerr << *msg << '\n';
+	}
+}
+
+/*
+ * boost::get_error_info() returns a plain pointer to the stored value, a
+ * const pointer if the exception is passed as a const reference. The pointer
+ * doesn't own anything and remains valid for the lifetime of the exception
+ * object, which in a catch handler is at least until the handler is left.
+ * There is no need for another lookup function returning a raw pointer or
+ * std::optional.
+ *
+ * Inside Boost.Exception, the lookup searches a std::map keyed by std::type_info
+ * and briefly copies a boost::shared_ptr to the stored error_info, which
+ * increments and decrements an atomic reference count once per call. This
+ * happens inside the library and can't be avoided from the outside.
+ *
+ * The above example measures the cost of one lookup when the exception carries 1,
+ * 8 and 64 values. errmsg_info is always added last, and the other values use the
+ * tag types tag_index<0> to tag_index<62>. Since the values are kept in a search
+ * tree, the time grows with the logarithm of the number of values. Handlers that
+ * need the same value many times should look it up once and keep the pointer.
+ *
+ */
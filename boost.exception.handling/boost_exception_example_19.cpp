@@ -0,0 +1,243 @@
+// Writing diagnostic information without building a std::string
+//
+#include <boost/exception/all.hpp>
+#include <boost/core/demangle.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+#include <typeinfo>
+#include <iostream>
+#include <unistd.h>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_requested_size, std::size_t> requested_size_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+template <class T>
+struct is_number : std::integral_constant<bool, std::is_integral<T>::value &&
+	!std::is_same<T, bool>::value && !std::is_same<T, char>::value &&
+	!std::is_same<T, signed char>::value && !std::is_same<T, unsigned char>::value &&
+	!std::is_same<T, wchar_t>::value && !std::is_same<T, char16_t>::value &&
+	!std::is_same<T, char32_t>::value>
+{
+};
+
+class diagnostic_sink
+{
+public:
+	typedef bool (*write_function)(void* context, const char* data, std::size_t size);
+
+	diagnostic_sink(write_function write, void* context)
+		: write_(write), context_(context), truncated_(false)
+	{
+	}
+
+	diagnostic_sink& operator<<(const char* s)
+	{
+		return write(s, std::strlen(s));
+	}
+
+	diagnostic_sink& operator<<(const std::string& s)
+	{
+		return write(s.data(), s.size());
+	}
+
+	template <class T>
+	typename std::enable_if<is_number<T>::value, diagnostic_sink&>::type
+	operator<<(T value)
+	{
+		char digits[24];
+		std::to_chars_result r = std::to_chars(digits, digits + sizeof(digits), value);
+		return write(digits, r.ptr - digits);
+	}
+
+	diagnostic_sink& write(const char* data, std::size_t size)
+	{
+		if (!truncated_ && !write_(context_, data, size))
+			truncated_ = true;
+		return *this;
+	}
+
+	bool truncated() const
+	{
+		return truncated_;
+	}
+
+private:
+	write_function write_;
+	void* context_;
+	bool truncated_;
+};
+
+struct fixed_buffer
+{
+	char* data;
+	std::size_t capacity;
+	std::size_t size;
+
+	static bool write(void* context, const char* data, std::size_t size)
+	{
+		fixed_buffer& b = *static_cast<fixed_buffer*>(context);
+		std::size_t n = std::min(size, b.capacity - b.size);
+		std::memcpy(b.data + b.size, data, n);
+		b.size += n;
+		return n == size;
+	}
+};
+
+bool write_to_fd(void* context, const char* data, std::size_t size)
+{
+	int fd = *static_cast<int*>(context);
+	while (size > 0)
+	{
+		ssize_t n = ::write(fd, data, size);
+		if (n <= 0)
+			return false;
+		data += n;
+		size -= n;
+	}
+	return true;
+}
+
+template <class Tag, class T>
+void write_error_info(diagnostic_sink& sink, const boost::exception& e,
+	boost::error_info<Tag, T>*)
+{
+	if (const T* v = boost::get_error_info<boost::error_info<Tag, T>>(e))
+	{
+		boost::core::scoped_demangled_name tag(typeid(Tag*).name());
+		sink << "[" << (tag.get() ? tag.get() : "?") << "] = ";
+		if constexpr (is_number<T>::value || std::is_same<T, std::string>::value)
+			sink << *v;
+		else
+			sink << boost::to_string_stub(*v);
+		sink << "\n";
+	}
+}
+
+template <class... ErrorInfos>
+bool write_diagnostic_information(diagnostic_sink& sink, const boost::exception& e)
+{
+	const char* const* file = boost::get_error_info<boost::throw_file>(e);
+	const int* line = boost::get_error_info<boost::throw_line>(e);
+	const char* const* function = boost::get_error_info<boost::throw_function>(e);
+	if (!file && !line && !function)
+		sink << "Throw location unknown (consider using BOOST_THROW_EXCEPTION)\n";
+	else
+	{
+		if (file)
+		{
+			sink << *file;
+			if (line)
+				sink << "(" << *line << "): ";
+		}
+		sink << "Throw in function " << (function ? *function : "(unknown)") << "\n";
+	}
+
+	boost::core::scoped_demangled_name type(typeid(e).name());
+	sink << "Dynamic exception type: " << (type.get() ? type.get() : "?") << "\n";
+
+	if (const std::exception* se = dynamic_cast<const std::exception*>(&e))
+		sink << "std::exception::what: " << se->what() << "\n";
+
+	(write_error_info(sink, e, static_cast<ErrorInfos*>(nullptr)), ...);
+	return !sink.truncated();
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+			requested_size_info(size));
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+int main()
+{
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		int fd = STDERR_FILENO;
+		diagnostic_sink to_stderr(write_to_fd, &fd);
+		write_diagnostic_information<errmsg_info, requested_size_info>(to_stderr, e);
+
+		char storage[64];
+		fixed_buffer buffer{storage, sizeof(storage), 0};
+		diagnostic_sink to_buffer(fixed_buffer::write, &buffer);
+		if (!write_diagnostic_information<errmsg_info, requested_size_info>(to_buffer, e))
+			std::cerr << "truncated after " << buffer.size << " bytes: "
+				<< std::string(buffer.data, buffer.size) << '\n';
+	}
+}
+
+/*
+ * boost::diagnostic_information() collects the whole report in a std::ostringstream
+ * and returns it as a std::string, which the caller then writes somewhere else.
+ * Under a storm of exceptions, that is a lot of extra allocation.
+ *
+ * The above example writes the report piece by piece to a diagnostic_sink. A sink
+ * is a function pointer plus a context pointer. The function receives each piece
+ * and returns false if it couldn't take all of it. From then on the sink drops all
+ * further output and truncated() returns true, so the output never grows beyond
+ * what the destination can hold. Two sinks are provided: fixed_buffer copies into
+ * a caller-provided array, and write_to_fd() calls write() on a file descriptor.
+ * Any other destination only needs a function with the same signature.
+ *
+ * write_diagnostic_information() produces the same format as
+ * boost::diagnostic_information(): the throw location, the dynamic type of the
+ * exception, what() and one line per error_info. Numbers are formatted with
+ * std::to_chars() into a small array on the stack. Strings are written directly.
+ * bool and the character types are integral types as well, but
+ * boost::diagnostic_information() prints them through a std::ostream, which
+ * writes a char as a character, not as its code. is_number excludes them from the
+ * fast path, so they take the same route as Boost.
+ *
+ * Boost.Exception doesn't offer a way to enumerate the stored values without
+ * formatting them into a string, so the error_info types to print are passed as
+ * template parameters. Their lines appear in that order, which may differ from
+ * the order boost::diagnostic_information() uses. Values of other types than
+ * numbers and std::string are still converted with boost::to_string_stub(), the
+ * function Boost.Exception uses itself.
+ *
+ * Type names are demangled with boost::core::scoped_demangled_name, which releases
+ * the buffer of the C++ runtime at the end of the scope instead of copying it into
+ * a std::string.
+ *
+ */
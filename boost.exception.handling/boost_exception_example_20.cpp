@@ -0,0 +1,231 @@
+// Reporting the last exception from signal handlers and std::terminate()
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <typeinfo>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <cstddef>
+#include <cstdlib>
+#include <unistd.h>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+struct exception_record
+{
+	const char* file;
+	int line;
+	const char* function;
+	const char* type;
+	char errmsg[256];
+	std::atomic<bool> valid;
+};
+
+static_assert(std::atomic<bool>::is_always_lock_free,
+	"valid is read in signal handlers");
+
+exception_record last_exception;
+std::atomic_flag recording = ATOMIC_FLAG_INIT;
+
+void record_exception(const boost::exception& e)
+{
+	if (recording.test_and_set(std::memory_order_acquire))
+		return;
+	last_exception.valid.store(false, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	const char* const* file = boost::get_error_info<boost::throw_file>(e);
+	const int* line = boost::get_error_info<boost::throw_line>(e);
+	const char* const* function = boost::get_error_info<boost::throw_function>(e);
+	last_exception.file = file ? *file : nullptr;
+	last_exception.line = line ? *line : 0;
+	last_exception.function = function ? *function : nullptr;
+	last_exception.type = typeid(e).name();
+
+	last_exception.errmsg[0] = '\0';
+	if (const std::string* msg = boost::get_error_info<errmsg_info>(e))
+	{
+		std::size_t n = std::min(msg->size(), sizeof(last_exception.errmsg) - 1);
+		std::memcpy(last_exception.errmsg, msg->data(), n);
+		last_exception.errmsg[n] = '\0';
+	}
+
+	last_exception.valid.store(true, std::memory_order_release);
+	recording.clear(std::memory_order_release);
+}
+
+void clear_exception_record()
+{
+	last_exception.valid.store(false, std::memory_order_release);
+}
+
+void write_string(int fd, const char* s)
+{
+	if (s)
+		(void)::write(fd, s, std::strlen(s));
+}
+
+void write_number(int fd, int value)
+{
+	char digits[12];
+	char* p = digits + sizeof(digits);
+	unsigned int v = value < 0 ? 0u - static_cast<unsigned int>(value) : value;
+	do
+	{
+		*--p = static_cast<char>('0' + v % 10);
+		v /= 10;
+	} while (v != 0);
+	if (value < 0)
+		*--p = '-';
+	(void)::write(fd, p, digits + sizeof(digits) - p);
+}
+
+void emit_crash_report(int fd, const char* reason)
+{
+	write_string(fd, "*** ");
+	write_string(fd, reason);
+	write_string(fd, " ***\n");
+	if (!last_exception.valid.load(std::memory_order_acquire))
+	{
+		write_string(fd, "No boost::exception in flight\n");
+		return;
+	}
+
+	if (last_exception.file)
+	{
+		write_string(fd, last_exception.file);
+		write_string(fd, "(");
+		write_number(fd, last_exception.line);
+		write_string(fd, "): ");
+	}
+	write_string(fd, "Throw in function ");
+	write_string(fd, last_exception.function ? last_exception.function : "(unknown)");
+	write_string(fd, "\nDynamic exception type (mangled): ");
+	write_string(fd, last_exception.type);
+	write_string(fd, "\n[tag_errmsg*] = ");
+	write_string(fd, last_exception.errmsg);
+	write_string(fd, "\n");
+}
+
+void on_fatal_signal(int signal)
+{
+	emit_crash_report(STDERR_FILENO, signal == SIGSEGV ? "SIGSEGV" : "SIGABRT");
+	std::signal(signal, SIG_DFL);
+	std::raise(signal);
+}
+
+void on_terminate()
+{
+	emit_crash_report(STDERR_FILENO, "std::terminate");
+	std::signal(SIGABRT, SIG_DFL);
+	std::abort();
+}
+
+void install_crash_handlers()
+{
+	std::signal(SIGSEGV, on_fatal_signal);
+	std::signal(SIGABRT, on_fatal_signal);
+	std::set_terminate(on_terminate);
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		record_exception(e);
+		throw;
+	}
+}
+
+int main()
+{
+	install_crash_handlers();
+
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(boost::exception&)
+	{
+		clear_exception_record();
+	}
+
+	char* c = write_lots_of_zeros();
+	delete[] c;
+}
+
+/*
+ * When a program crashes, the most useful piece of information is often the last
+ * exception that was thrown. But signal handlers for SIGSEGV or SIGABRT may only
+ * call async-signal-safe functions. boost::diagnostic_information() allocates
+ * memory and uses iostreams, and both are forbidden there. The memory of the
+ * exception may even be the reason for the crash.
+ *
+ * The above example splits the work in two. record_exception() is called where the
+ * exception is annotated and copies what is needed into the global object
+ * last_exception: pointers to the file, the function and the mangled type name,
+ * which all refer to static storage, the line number, and the error message, which
+ * is copied into a fixed array of 256 bytes. Nothing is formatted at this point,
+ * so recording costs little more than the lookups themselves.
+ *
+ * emit_crash_report() formats the record only when it is needed. It uses nothing
+ * but write(2), strlen() and a hand-written conversion of the line number, all of
+ * which are async-signal-safe. The member valid is cleared while the record is
+ * being updated, so a handler that interrupts record_exception() reports that no
+ * exception is available instead of printing half of one. valid is a lock-free
+ * std::atomic<bool>, which may be used in signal handlers, and the release fence
+ * and release store keep the other stores between its two updates.
+ *
+ * install_crash_handlers() registers the report for SIGSEGV and SIGABRT and
+ * through std::set_terminate(). main() first handles an exception and calls
+ * clear_exception_record(), which should be done whenever an exception has been
+ * handled, so a later crash doesn't report a stale exception. The second exception
+ * isn't caught, so the program ends in std::terminate(), which prints the report
+ * and aborts. The handlers reset the signal to its default action before raising
+ * it again, so the program still terminates with the original signal and a core
+ * dump can be written.
+ *
+ * The dynamic type is printed in its mangled form, because demangling requires
+ * memory allocation. The tool c++filt turns it back into a readable name.
+ *
+ * With several threads, only one may write last_exception at a time. The
+ * std::atomic_flag recording serves as a try-lock: a thread that finds another
+ * one recording skips its own exception instead of waiting, because waiting isn't
+ * possible if the other thread is interrupted by a signal handler. last_exception
+ * therefore holds a complete record of a recent exception, but not necessarily of
+ * the very last one. If one thread crashes while another one starts recording, the
+ * report may mix two exceptions; the record is a best-effort hint, not proof.
+ *
+ */
@@ -0,0 +1,422 @@
+// Sending exceptions to another process in binary form
+//
+#include <boost/exception/all.hpp>
+#include <boost/exception_ptr.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <unordered_set>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_requested_size, std::size_t> requested_size_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+struct unknown_remote_exception : public boost::exception, public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "unknown remote exception";
+	}
+};
+
+struct codec_error : public boost::exception, public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "codec error";
+	}
+};
+
+class writer
+{
+public:
+	explicit writer(std::string& out) : out_(out) {}
+
+	void byte(std::uint8_t b)
+	{
+		out_ += static_cast<char>(b);
+	}
+
+	void varint(std::uint64_t v)
+	{
+		for (; v >= 0x80; v >>= 7)
+			byte(static_cast<std::uint8_t>(v | 0x80));
+		byte(static_cast<std::uint8_t>(v));
+	}
+
+	void string(const char* s, std::size_t n)
+	{
+		varint(n);
+		out_.append(s, n);
+	}
+
+	std::size_t size() const
+	{
+		return out_.size();
+	}
+
+	void insert_varint(std::size_t at, std::uint64_t v)
+	{
+		char bytes[10];
+		std::size_t n = 0;
+		for (; v >= 0x80; v >>= 7)
+			bytes[n++] = static_cast<char>(v | 0x80);
+		bytes[n++] = static_cast<char>(v);
+		out_.insert(at, bytes, n);
+	}
+
+private:
+	std::string& out_;
+};
+
+class reader
+{
+public:
+	reader(const char* data, std::size_t size) : p_(data), end_(data + size) {}
+
+	std::uint8_t byte()
+	{
+		if (p_ == end_)
+			BOOST_THROW_EXCEPTION(codec_error{} << errmsg_info("unexpected end of input"));
+		return static_cast<std::uint8_t>(*p_++);
+	}
+
+	std::uint64_t varint()
+	{
+		std::uint64_t v = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			std::uint8_t b = byte();
+			v |= std::uint64_t(b & 0x7f) << shift;
+			if (!(b & 0x80))
+				return v;
+		}
+		BOOST_THROW_EXCEPTION(codec_error{} << errmsg_info("varint too long"));
+	}
+
+	std::string string()
+	{
+		std::uint64_t n = varint();
+		if (n > std::uint64_t(end_ - p_))
+			BOOST_THROW_EXCEPTION(codec_error{} << errmsg_info("string too long"));
+		std::string s(p_, n);
+		p_ += n;
+		return s;
+	}
+
+	reader sub(std::uint64_t n)
+	{
+		if (n > std::uint64_t(end_ - p_))
+			BOOST_THROW_EXCEPTION(codec_error{} << errmsg_info("field too long"));
+		reader r(p_, n);
+		p_ += n;
+		return r;
+	}
+
+	bool done() const
+	{
+		return p_ == end_;
+	}
+
+private:
+	const char* p_;
+	const char* end_;
+};
+
+void encode_value(writer& w, const std::string& v)
+{
+	w.string(v.data(), v.size());
+}
+
+void encode_value(writer& w, std::size_t v)
+{
+	w.varint(v);
+}
+
+void decode_value(reader& r, std::string& v)
+{
+	v = r.string();
+}
+
+void decode_value(reader& r, std::size_t& v)
+{
+	v = r.varint();
+}
+
+struct error_info_codec
+{
+	std::uint8_t id;
+	bool (*encode)(writer&, const boost::exception&);
+	void (*decode)(reader&, const boost::exception&);
+};
+
+template <class ErrorInfo>
+bool encode_error_info(writer& w, const boost::exception& e)
+{
+	const typename ErrorInfo::value_type* v = boost::get_error_info<ErrorInfo>(e);
+	if (v)
+		encode_value(w, *v);
+	return v != nullptr;
+}
+
+template <class ErrorInfo>
+void decode_error_info(reader& r, const boost::exception& e)
+{
+	typename ErrorInfo::value_type v;
+	decode_value(r, v);
+	e << ErrorInfo(v);
+}
+
+const error_info_codec error_info_codecs[] = {
+	{ 1, encode_error_info<errmsg_info>, decode_error_info<errmsg_info> },
+	{ 2, encode_error_info<requested_size_info>, decode_error_info<requested_size_info> },
+};
+
+struct exception_codec
+{
+	std::uint8_t id;
+	bool (*matches)(const boost::exception&);
+	boost::exception_ptr (*rebuild)(reader&, void (*)(reader&, const boost::exception&));
+};
+
+template <class E>
+bool matches(const boost::exception& e)
+{
+	return dynamic_cast<const E*>(&e) != nullptr;
+}
+
+template <class E>
+boost::exception_ptr rebuild(reader& r, void (*decode_body)(reader&, const boost::exception&))
+{
+	auto x = boost::enable_error_info(E{});
+	decode_body(r, x);
+	return boost::copy_exception(x);
+}
+
+const exception_codec exception_codecs[] = {
+	{ 1, matches<allocation_failed>, rebuild<allocation_failed> },
+};
+
+const char* intern(const std::string& s)
+{
+	const std::size_t max_strings = 1024;
+	const std::size_t max_length = 1024;
+	static std::mutex mutex;
+	static std::unordered_set<std::string> strings;
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = strings.find(s);
+	if (it != strings.end())
+		return it->c_str();
+	if (strings.size() == max_strings || s.size() > max_length)
+		return "(unknown)";
+	return strings.insert(s).first->c_str();
+}
+
+void encode_exception(std::string& out, const boost::exception& e)
+{
+	out.clear();
+	writer w(out);
+
+	std::uint8_t type = 0;
+	for (const exception_codec& c : exception_codecs)
+		if (c.matches(e))
+			type = c.id;
+	w.byte(type);
+
+	const char* const* file = boost::get_error_info<boost::throw_file>(e);
+	const int* line = boost::get_error_info<boost::throw_line>(e);
+	const char* const* function = boost::get_error_info<boost::throw_function>(e);
+	w.byte(file && line && function);
+	if (file && line && function)
+	{
+		w.string(*file, std::char_traits<char>::length(*file));
+		w.varint(static_cast<std::uint32_t>(*line));
+		w.string(*function, std::char_traits<char>::length(*function));
+	}
+
+	for (const error_info_codec& c : error_info_codecs)
+	{
+		std::size_t start = w.size();
+		w.byte(c.id);
+		if (!c.encode(w, e))
+			out.resize(start);
+		else
+			w.insert_varint(start + 1, w.size() - start - 1);
+	}
+}
+
+void decode_body(reader& r, const boost::exception& e)
+{
+	if (r.byte())
+	{
+		e << boost::throw_file(intern(r.string()));
+		e << boost::throw_line(static_cast<int>(r.varint()));
+		e << boost::throw_function(intern(r.string()));
+	}
+
+	while (!r.done())
+	{
+		std::uint8_t id = r.byte();
+		reader value = r.sub(r.varint());
+		for (const error_info_codec& c : error_info_codecs)
+		{
+			if (c.id == id)
+			{
+				c.decode(value, e);
+				if (!value.done())
+					BOOST_THROW_EXCEPTION(codec_error{} <<
+						errmsg_info("error_info length mismatch"));
+			}
+		}
+	}
+}
+
+boost::exception_ptr decode_exception(const std::string& in)
+{
+	reader r(in.data(), in.size());
+	std::uint8_t type = r.byte();
+	for (const exception_codec& c : exception_codecs)
+		if (c.id == type)
+			return c.rebuild(r, decode_body);
+
+	unknown_remote_exception x;
+	decode_body(r, x);
+	return boost::copy_exception(x);
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+			requested_size_info(size));
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+void measure(const boost::exception& e)
+{
+	const int iterations = 100000;
+	std::string buffer;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		encode_exception(buffer, e);
+	std::chrono::duration<double> encoding = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		decode_exception(buffer);
+	std::chrono::duration<double> decoding = std::chrono::steady_clock::now() - start;
+
+	std::cout << "encoded: " << buffer.size() << " bytes, text: "
+		<< boost::diagnostic_information(e).size() << " bytes\n"
+		<< "encode: " << iterations / encoding.count() << " exceptions/s\n"
+		<< "decode: " << iterations / decoding.count() << " exceptions/s\n";
+}
+
+int main()
+{
+	std::string message;
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		measure(e);
+		encode_exception(message, e);
+	}
+
+	try
+	{
+		boost::rethrow_exception(decode_exception(message));
+	}
+	catch(allocation_failed& e)
+	{
+		std::cerr << *boost::get_error_info<errmsg_info>(e) << '\n'
+			<< boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * A worker process can pass a failure to its supervisor as the text produced by
+ * boost::diagnostic_information(), but the supervisor then has to parse that text
+ * to do anything but print it. The above example encodes the exception in a
+ * compact binary form instead, from which an equivalent exception can be rebuilt.
+ *
+ * An encoded exception starts with a byte identifying the type. exception_codecs
+ * lists the types that can be transported, each with a stable id, a function that
+ * recognizes the type with dynamic_cast, and a function that rebuilds it. Because
+ * BOOST_THROW_EXCEPTION throws a type derived from allocation_failed, the test
+ * can't compare std::type_info objects. If no codec matches, the id is 0 and the
+ * receiver creates an unknown_remote_exception.
+ *
+ * Next comes the throw location, if there is one: the file and the function as
+ * strings prefixed with their length, and the line number. Lengths and numbers
+ * are written as varints, which need a single byte for values below 128.
+ *
+ * The rest consists of the error_info values. Every type that should be
+ * transported is listed in error_info_codecs with its own stable id and two
+ * functions that write and read the value. Each value is preceded by its id and
+ * its length as a varint, so a receiver that doesn't know an id can skip the
+ * value. This lets sender and receiver be updated independently. Known values are
+ * decoded from a reader limited to their length, and if the codec doesn't consume
+ * exactly that many bytes, the codecs of sender and receiver disagree and
+ * decode_exception() throws codec_error instead of misreading the rest. Since the
+ * length is only known after the value has been written, it is inserted in front
+ * of the value afterwards.
+ *
+ * decode_exception() returns a boost::exception_ptr. The throw location is
+ * restored with the types boost::throw_file, boost::throw_line and
+ * boost::throw_function. Boost.Exception stores file and function as plain char
+ * pointers, which normally point to string literals, so the decoded strings are
+ * interned and live until the end of the program. A well-behaved sender only has
+ * a limited number of throw locations, but the decoder can't rely on that: a
+ * corrupt or hostile peer could send a new string with every message. intern()
+ * therefore keeps at most 1024 strings of up to 1024 bytes each. Once the set is
+ * full, or for a longer string, it returns "(unknown)" instead, so the memory
+ * used for throw locations is bounded no matter what the peer sends.
+ *
+ * After boost::rethrow_exception(), the exception can be caught as
+ * allocation_failed, and boost::get_error_info<errmsg_info>() works as if it had
+ * been thrown locally. The dynamic type differs from the original, because the
+ * rebuilt exception is created with boost::enable_error_info().
+ *
+ * measure() compares the size of the encoding with the size of the text and
+ * prints how many exceptions per second can be encoded and decoded.
+ *
+ */
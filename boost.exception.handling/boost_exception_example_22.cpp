@@ -0,0 +1,360 @@
+// Writing diagnostic information as JSON
+//
+#include <boost/exception/all.hpp>
+#include <boost/core/demangle.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <cstddef>
+#include <cstdlib>
+#include <type_traits>
+#include <typeinfo>
+#include <iostream>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_requested_size, std::size_t> requested_size_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+bool needs_escape(unsigned char c)
+{
+	return c < 0x20 || c == '"' || c == '\\';
+}
+
+const char* find_escape(const char* p, const char* end)
+{
+#ifdef __SSE2__
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i space = _mm_set1_epi8(0x20);
+	for (; end - p >= 16; p += 16)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i control = _mm_cmpeq_epi8(_mm_max_epu8(chunk, space), space);
+		control = _mm_andnot_si128(_mm_cmpeq_epi8(chunk, space), control);
+		__m128i special = _mm_or_si128(_mm_or_si128(
+			_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)), control);
+		int mask = _mm_movemask_epi8(special);
+		if (mask)
+			return p + __builtin_ctz(mask);
+	}
+#endif
+	while (p != end && !needs_escape(static_cast<unsigned char>(*p)))
+		++p;
+	return p;
+}
+
+void append_escaped(std::string& out, const char* s, std::size_t size)
+{
+	static const char hex[] = "0123456789abcdef";
+	const char* end = s + size;
+	out += '"';
+	while (s != end)
+	{
+		const char* special = find_escape(s, end);
+		out.append(s, special - s);
+		if (special == end)
+			break;
+
+		unsigned char c = static_cast<unsigned char>(*special);
+		switch (c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			out += "\\u00";
+			out += hex[c >> 4];
+			out += hex[c & 0xf];
+		}
+		s = special + 1;
+	}
+	out += '"';
+}
+
+void append_escaped(std::string& out, const char* s)
+{
+	append_escaped(out, s, std::strlen(s));
+}
+
+template <class T>
+void append_number(std::string& out, T value)
+{
+	char digits[24];
+	std::to_chars_result r = std::to_chars(digits, digits + sizeof(digits), value);
+	out.append(digits, r.ptr - digits);
+}
+
+void append_character(std::string& out, char32_t c)
+{
+	char bytes[4];
+	std::size_t n;
+	if (c < 0x80)
+	{
+		bytes[0] = static_cast<char>(c);
+		n = 1;
+	}
+	else if (c < 0x800)
+	{
+		bytes[0] = static_cast<char>(0xc0 | (c >> 6));
+		bytes[1] = static_cast<char>(0x80 | (c & 0x3f));
+		n = 2;
+	}
+	else if (c < 0x10000 && (c < 0xd800 || c > 0xdfff))
+	{
+		bytes[0] = static_cast<char>(0xe0 | (c >> 12));
+		bytes[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+		bytes[2] = static_cast<char>(0x80 | (c & 0x3f));
+		n = 3;
+	}
+	else if (c >= 0x10000 && c < 0x110000)
+	{
+		bytes[0] = static_cast<char>(0xf0 | (c >> 18));
+		bytes[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+		bytes[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+		bytes[3] = static_cast<char>(0x80 | (c & 0x3f));
+		n = 4;
+	}
+	else
+	{
+		append_character(out, 0xfffd);
+		return;
+	}
+	append_escaped(out, bytes, n);
+}
+
+template <class T>
+struct is_character : std::integral_constant<bool, std::is_same<T, char>::value ||
+	std::is_same<T, signed char>::value || std::is_same<T, unsigned char>::value ||
+	std::is_same<T, wchar_t>::value || std::is_same<T, char16_t>::value ||
+	std::is_same<T, char32_t>::value>
+{
+};
+
+void append_key(std::string& out, const char* key, std::size_t size)
+{
+	out += ',';
+	append_escaped(out, key, size);
+	out += ':';
+}
+
+void append_key(std::string& out, const char* key)
+{
+	append_key(out, key, std::strlen(key));
+}
+
+template <class Tag, class T>
+void append_error_info(std::string& out, const boost::exception& e,
+	boost::error_info<Tag, T>*)
+{
+	if (const T* v = boost::get_error_info<boost::error_info<Tag, T>>(e))
+	{
+		boost::core::scoped_demangled_name tag(typeid(Tag*).name());
+		const char* name = tag.get() ? tag.get() : "?";
+		std::size_t size = std::strlen(name);
+		append_key(out, name, size && name[size - 1] == '*' ? size - 1 : size);
+		if constexpr (std::is_same<T, bool>::value)
+			out += *v ? "true" : "false";
+		else if constexpr (is_character<T>::value && sizeof(T) == 1)
+			append_escaped(out, reinterpret_cast<const char*>(v), 1);
+		else if constexpr (is_character<T>::value)
+			append_character(out, static_cast<std::make_unsigned_t<T>>(*v));
+		else if constexpr (std::is_integral<T>::value)
+			append_number(out, *v);
+		else if constexpr (std::is_same<T, std::string>::value)
+			append_escaped(out, v->data(), v->size());
+		else
+		{
+			std::string s = boost::to_string_stub(*v);
+			append_escaped(out, s.data(), s.size());
+		}
+	}
+}
+
+template <class... ErrorInfos>
+const std::string& write_json(std::string& out, const boost::exception& e)
+{
+	out.clear();
+	out += '{';
+
+	boost::core::scoped_demangled_name type(typeid(e).name());
+	out += "\"dynamic_type\":";
+	append_escaped(out, type.get() ? type.get() : "?");
+
+	if (const char* const* file = boost::get_error_info<boost::throw_file>(e))
+	{
+		append_key(out, "throw_file");
+		append_escaped(out, *file);
+	}
+	if (const int* line = boost::get_error_info<boost::throw_line>(e))
+	{
+		append_key(out, "throw_line");
+		append_number(out, *line);
+	}
+	if (const char* const* function = boost::get_error_info<boost::throw_function>(e))
+	{
+		append_key(out, "throw_function");
+		append_escaped(out, *function);
+	}
+	if (const std::exception* se = dynamic_cast<const std::exception*>(&e))
+	{
+		append_key(out, "what");
+		append_escaped(out, se->what());
+	}
+
+	(append_error_info(out, e, static_cast<ErrorInfos*>(nullptr)), ...);
+	out += '}';
+	return out;
+}
+
+bool check_golden()
+{
+	auto e = boost::enable_error_info(allocation_failed{}) <<
+		boost::throw_file("example.cpp") << boost::throw_line(42) <<
+		boost::throw_function("char* allocate_memory(std::size_t)") <<
+		errmsg_info("say \"zero\"\\\n\x01 and a long tail without escapes") <<
+		requested_size_info(18446744073709551615u);
+
+	const std::string prefix = "{\"dynamic_type\":\"";
+	const char* golden =
+		",\"throw_file\":\"example.cpp\",\"throw_line\":42,"
+		"\"throw_function\":\"char* allocate_memory(std::size_t)\","
+		"\"what\":\"allocation failed\","
+		"\"tag_errmsg\":\"say \\\"zero\\\"\\\\\\n\\u0001 and a long tail without escapes\","
+		"\"tag_requested_size\":18446744073709551615}";
+
+	std::string out;
+	write_json<errmsg_info, requested_size_info>(out, e);
+	if (out.compare(0, prefix.size(), prefix) != 0)
+		return false;
+	std::string::size_type end = out.find('"', prefix.size());
+	if (end == std::string::npos || out.find("allocation_failed", prefix.size()) > end)
+		return false;
+	return out.compare(end + 1, std::string::npos, golden) == 0;
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+			requested_size_info(size));
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+void measure(const boost::exception& e)
+{
+	const int iterations = 100000;
+	std::string buffer;
+
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		write_json<errmsg_info, requested_size_info>(buffer, e);
+	std::chrono::duration<double> json = std::chrono::steady_clock::now() - start;
+
+	start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		boost::diagnostic_information(e);
+	std::chrono::duration<double> text = std::chrono::steady_clock::now() - start;
+
+	std::cout << "write_json:             " << iterations / json.count() << " exceptions/s\n"
+		<< "diagnostic_information: " << iterations / text.count() << " exceptions/s\n";
+}
+
+int main()
+{
+	if (!check_golden())
+	{
+		std::cerr << "golden: MISMATCH\n";
+		return EXIT_FAILURE;
+	}
+	std::cout << "golden: ok\n";
+
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		measure(e);
+
+		std::string buffer;
+		std::cerr << write_json<errmsg_info, requested_size_info>(buffer, e) << '\n';
+	}
+}
+
+/*
+ * Log pipelines that parse the text of boost::diagnostic_information() depend on
+ * a format that was written for humans. The above example writes the same
+ * information as a single JSON object with one member per field: dynamic_type,
+ * throw_file, throw_line, throw_function, what and one member for each error_info,
+ * named after its tag. Tags are usually incomplete types, so the name is taken
+ * from typeid of a pointer to the tag, and the trailing asterisk is dropped.
+ * Members are left out if the exception doesn't carry the value.
+ *
+ * write_json() writes into a std::string passed by the caller and starts by
+ * clearing it. clear() keeps the capacity, so a buffer that is reused for every
+ * exception stops allocating once it is large enough. No other strings are
+ * created: numbers are formatted with std::to_chars() on the stack, and type names
+ * are demangled with boost::core::scoped_demangled_name. bool becomes true or
+ * false. Character types are integral as well, but a character is written as a
+ * string of one character, encoded as UTF-8 if it is wider than a byte, and a code
+ * that isn't a valid code point becomes U+FFFD. Only values of other types than
+ * these, integers and std::string go through boost::to_string_stub(). As in
+ * Example 19, the error_info types to write are passed as template parameters,
+ * because Boost.Exception can't enumerate the stored values.
+ *
+ * Strings have to be escaped: quotes, backslashes and control characters below
+ * 0x20. Most messages contain none of them, so find_escape() uses SSE2 to check 16
+ * bytes at a time and append_escaped() copies everything up to the next special
+ * character in one call. Control characters are found with an unsigned maximum:
+ * max(c, 0x20) equals 0x20 only for bytes up to 0x20, and the space itself is
+ * excluded again. Without SSE2, and for the last bytes of a string, a plain loop
+ * is used. Bytes above 0x7f are copied unchanged, so UTF-8 passes through.
+ *
+ * check_golden() builds an allocation_failed with a fixed throw location, an
+ * errmsg_info with every kind of special character and a requested_size_info, and
+ * compares the result with the expected JSON. The name of the dynamic type
+ * depends on the Boost release, because boost::enable_error_info() wraps the
+ * exception in an internal class template, so check_golden() only checks that it
+ * contains allocation_failed and compares everything after it exactly. On a
+ * mismatch, main() exits with EXIT_FAILURE. measure() compares how many exceptions
+ * per second write_json() and boost::diagnostic_information() can format.
+ *
+ */
@@ -0,0 +1,273 @@
+// Collecting failures from many threads in a lock-free ring
+//
+#include <boost/exception/all.hpp>
+#include <boost/exception_ptr.hpp>
+#include <boost/assert.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_producer, std::size_t> producer_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+template <class T>
+class mpsc_ring
+{
+public:
+	explicit mpsc_ring(std::size_t capacity)
+		: cells_(new cell[capacity]), mask_(capacity - 1), head_(0), tail_(0)
+	{
+		BOOST_ASSERT(capacity && !(capacity & (capacity - 1)));
+		for (std::size_t i = 0; i < capacity; ++i)
+			cells_[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	bool try_push(T& value)
+	{
+		std::size_t pos = head_.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			cell& c = cells_[pos & mask_];
+			std::size_t sequence = c.sequence.load(std::memory_order_acquire);
+			std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence - pos);
+			if (diff == 0)
+			{
+				if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					c.value = std::move(value);
+					c.sequence.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+				return false;
+			else
+				pos = head_.load(std::memory_order_relaxed);
+		}
+	}
+
+	template <class F>
+	std::size_t drain(F f, std::size_t max)
+	{
+		std::size_t n = 0;
+		for (; n < max; ++n, ++tail_)
+		{
+			cell& c = cells_[tail_ & mask_];
+			if (c.sequence.load(std::memory_order_acquire) != tail_ + 1)
+				break;
+			f(std::move(c.value));
+			c.value = T();
+			c.sequence.store(tail_ + mask_ + 1, std::memory_order_release);
+		}
+		return n;
+	}
+
+private:
+	struct alignas(64) cell
+	{
+		std::atomic<std::size_t> sequence;
+		T value;
+	};
+
+	std::unique_ptr<cell[]> cells_;
+	const std::size_t mask_;
+	alignas(64) std::atomic<std::size_t> head_;
+	alignas(64) std::size_t tail_;
+};
+
+template <class T>
+class mutex_queue
+{
+public:
+	bool try_push(T& value)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		queue_.push(std::move(value));
+		return true;
+	}
+
+	template <class F>
+	std::size_t drain(F f, std::size_t max)
+	{
+		std::size_t n = 0;
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (; n < max && !queue_.empty(); ++n)
+		{
+			f(std::move(queue_.front()));
+			queue_.pop();
+		}
+		return n;
+	}
+
+private:
+	std::mutex mutex_;
+	std::queue<T> queue_;
+};
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+boost::exception_ptr failure_of(std::size_t producer)
+{
+	try
+	{
+		try
+		{
+			char* c = write_lots_of_zeros();
+			delete[] c;
+		}
+		catch(boost::exception& e)
+		{
+			e << producer_info(producer);
+			throw;
+		}
+	}
+	catch(...)
+	{
+		return boost::current_exception();
+	}
+	return boost::exception_ptr();
+}
+
+template <class Queue>
+double failures_per_second(std::size_t producers, boost::exception_ptr& first)
+{
+	const std::size_t per_producer = (1 << 18) / producers;
+	const std::size_t total = per_producer * producers;
+	Queue queue;
+	std::vector<boost::exception_ptr> failures;
+	for (std::size_t p = 0; p < producers; ++p)
+		failures.push_back(failure_of(p));
+
+	auto start = std::chrono::steady_clock::now();
+	std::vector<std::thread> threads;
+	for (std::size_t p = 0; p < producers; ++p)
+		threads.emplace_back([&queue, &failures, p, per_producer]{
+			for (std::size_t i = 0; i < per_producer; ++i)
+			{
+				boost::exception_ptr failure = failures[p];
+				while (!queue.try_push(failure))
+					std::this_thread::yield();
+			}
+		});
+
+	std::size_t received = 0;
+	while (received < total)
+	{
+		std::size_t n = queue.drain([&first](boost::exception_ptr&& failure){
+			if (!first)
+				first = std::move(failure);
+		}, 64);
+		if (n == 0)
+			std::this_thread::yield();
+		received += n;
+	}
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+	for (std::thread& t : threads)
+		t.join();
+	return total / elapsed.count();
+}
+
+struct ring : public mpsc_ring<boost::exception_ptr>
+{
+	ring() : mpsc_ring<boost::exception_ptr>(1024) {}
+};
+
+int main()
+{
+	boost::exception_ptr first;
+	for (std::size_t producers = 1; producers <= 64; producers *= 2)
+		std::cout << producers << " producers: "
+			<< failures_per_second<ring>(producers, first) << " failures/s lock-free, "
+			<< failures_per_second<mutex_queue<boost::exception_ptr>>(producers, first)
+			<< " failures/s with mutex\n";
+
+	try
+	{
+		boost::rethrow_exception(first);
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * The exception_ptr of Boost.Exception lets a worker thread hand its failure to
+ * another thread, as Example 10 does for a single failure. When many workers fail
+ * at the same time and push their exception_ptr into a std::queue protected by a
+ * mutex, they all wait for the same lock, and the thread that handles the failures
+ * competes with them for every single element.
+ *
+ * mpsc_ring in the above example is a bounded queue for many producers and one
+ * consumer that doesn't use a lock. The capacity must be a power of two, because
+ * positions are mapped to cells with a bit mask, and the constructor asserts this.
+ * Every cell has a sequence number that tells whether it is free for the producer
+ * that claims position pos (sequence equals pos) or filled for the consumer at
+ * that position (sequence equals pos + 1). A producer claims a position with a
+ * single compare-and-swap on head_, moves the exception_ptr into the cell and
+ * publishes it by storing the new sequence number. If the cell still belongs to
+ * the previous round, the ring is full and try_push() returns false without
+ * changing its argument, so the producer can retry or drop the failure.
+ *
+ * Only one thread may call drain(). It takes up to max consecutive filled cells,
+ * passes each exception_ptr to f and releases the cell for the next round. This
+ * needs no read-modify-write operation at all, because tail_ is only used by the
+ * consumer. Cells and the two positions are aligned to 64 bytes so producers and
+ * the consumer don't share cache lines. The emptied cell is reset to a null
+ * exception_ptr so that the exception isn't kept alive until the cell is reused.
+ *
+ * main() sends 2^18 failures from 1 to 64 producer threads through the ring with
+ * 1024 cells and through mutex_queue, which drains in batches of 64 as well. Each
+ * producer sends copies of its own exception_ptr, created once by catching the
+ * exception from write_lots_of_zeros() and adding the producer number. Copying an
+ * exception_ptr increments a reference count, so the copies share nothing across
+ * producers. The first failure received is printed at the end. With more producers
+ * than cores, yielding while the ring is full dominates the result.
+ *
+ */
@@ -0,0 +1,241 @@
+// Running many small jobs on a work-stealing pool and collecting their failures
+//
+#include <boost/exception/all.hpp>
+#include <boost/exception_ptr.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_task_index, std::size_t> task_index_info;
+typedef
+boost::error_info<struct tag_cancelled_tasks, std::size_t> cancelled_tasks_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+struct tasks_failed : public boost::exception, public std::exception
+{
+	std::vector<boost::exception_ptr> failures;
+
+	const char* what() const noexcept
+	{
+		return "tasks failed";
+	}
+};
+
+class task_queue
+{
+public:
+	void push(std::size_t index)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		tasks_.push_back(index);
+	}
+
+	bool pop(std::size_t& index)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (tasks_.empty())
+			return false;
+		index = tasks_.back();
+		tasks_.pop_back();
+		return true;
+	}
+
+	bool steal(std::size_t& index)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (tasks_.empty())
+			return false;
+		index = tasks_.front();
+		tasks_.pop_front();
+		return true;
+	}
+
+private:
+	alignas(64) std::mutex mutex_;
+	std::deque<std::size_t> tasks_;
+};
+
+template <class F>
+void run_tasks(std::size_t count, F f,
+	std::size_t thread_count = std::thread::hardware_concurrency())
+{
+	thread_count = std::max<std::size_t>(1, thread_count);
+	std::vector<task_queue> queues(thread_count);
+	for (std::size_t i = 0; i < count; ++i)
+		queues[i * thread_count / count].push(i);
+
+	std::atomic<bool> cancelled(false);
+	std::atomic<std::size_t> done(0);
+	std::mutex failure_mutex;
+	tasks_failed aggregate;
+
+	auto record = [&](boost::exception& e, std::size_t index){
+		e << task_index_info(index);
+		std::lock_guard<std::mutex> lock(failure_mutex);
+		aggregate.failures.push_back(boost::current_exception());
+		cancelled.store(true, std::memory_order_relaxed);
+	};
+
+	auto next = [&](std::size_t self, std::size_t& index){
+		if (queues[self].pop(index))
+			return true;
+		for (std::size_t i = 1; i < thread_count; ++i)
+			if (queues[(self + i) % thread_count].steal(index))
+				return true;
+		return false;
+	};
+
+	auto work = [&](std::size_t self){
+		std::size_t index;
+		while (!cancelled.load(std::memory_order_relaxed) && next(self, index))
+		{
+			try
+			{
+				try
+				{
+					f(index, cancelled);
+				}
+				catch(boost::exception& e)
+				{
+					record(e, index);
+				}
+				catch(...)
+				{
+					boost::rethrow_exception(boost::current_exception());
+				}
+			}
+			catch(boost::exception& e)
+			{
+				record(e, index);
+			}
+			done.fetch_add(1, std::memory_order_relaxed);
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (std::size_t t = 1; t < thread_count; ++t)
+		threads.emplace_back(work, t);
+	work(0);
+	for (std::thread& t : threads)
+		t.join();
+
+	if (!aggregate.failures.empty())
+		BOOST_THROW_EXCEPTION(aggregate << cancelled_tasks_info(count - done.load()));
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+void write_zeros(std::size_t size)
+{
+	try
+	{
+		char* c = allocate_memory(size);
+		std::fill_n(c, size, 0);
+		asm volatile("" : : "r"(c) : "memory");
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing zeros failed");
+		throw;
+	}
+}
+
+int main()
+{
+	const std::size_t tasks = 4096;
+	const std::size_t size = 256 * 1024;
+
+	for (std::size_t threads = 1; threads <= 64; threads *= 2)
+	{
+		auto start = std::chrono::steady_clock::now();
+		run_tasks(tasks, [size](std::size_t, const std::atomic<bool>&){
+			write_zeros(size);
+		}, threads);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		std::cout << threads << " threads: " << tasks / elapsed.count() << " tasks/s\n";
+	}
+
+	try
+	{
+		run_tasks(tasks, [size](std::size_t index, const std::atomic<bool>& cancelled){
+			if (!cancelled.load(std::memory_order_relaxed))
+				write_zeros(index == 1000 ? std::numeric_limits<std::size_t>::max() : size);
+		});
+	}
+	catch(tasks_failed& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+		for (const boost::exception_ptr& failure : e.failures)
+		{
+			try
+			{
+				boost::rethrow_exception(failure);
+			}
+			catch(boost::exception& child)
+			{
+				std::cerr << boost::diagnostic_information(child);
+			}
+		}
+	}
+}
+
+/*
+ * Splitting a large job into thousands of small tasks raises two questions: how
+ * the tasks are spread over the threads, and what happens when one of them throws.
+ * The above example answers both with run_tasks(), which calls f for every index
+ * from 0 to count - 1.
+ *
+ * Each thread owns a task_queue and starts with a contiguous range of indexes. It
+ * takes tasks from the back of its own queue. When the queue is empty, the thread
+ * steals from the front of the other queues, so threads that finish early help the
+ * slower ones instead of waiting. The queues are protected by a mutex each, which
+ * is only contended while stealing. The calling thread takes part as worker 0.
+ *
+ * A task that throws doesn't end its thread. The worker catches the exception, adds
+ * the index of the task as task_index_info, and stores boost::current_exception()
+ * in the list of failures. Exceptions that aren't derived from boost::exception
+ * are first turned into one by boost::current_exception() and
+ * boost::rethrow_exception(), so they get the index too. The first failure sets
+ * the flag cancelled. Workers check it before taking the next task, and tasks
+ * receive it as a parameter so that long-running ones can stop early. Tasks that
+ * are already running when the flag is set may still fail, which is why all
+ * failures are kept and not just the first one.
+ *
+ * After all threads have been joined, run_tasks() throws tasks_failed. Its member
+ * failures holds the exception_ptr of every failed task, and cancelled_tasks_info
+ * says how many tasks never ran. The caller can rethrow each child with
+ * boost::rethrow_exception() to get at its own error_info values.
+ *
+ * main() runs 4096 tasks that each fill 256 KiB with 1 to 64 threads and prints
+ * the number of tasks per second. Then task 1000 asks for too much memory, and the
+ * aggregate exception and the failure of that task are printed.
+ *
+ */
@@ -0,0 +1,233 @@
+// Nesting exceptions and walking the chain of causes
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_layer, int> layer_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+struct layer_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "layer failed";
+	}
+};
+
+struct cause
+{
+	std::exception_ptr ptr;
+	const boost::exception* exception;
+};
+
+std::string to_string(const cause& c)
+{
+	return "\n" + boost::diagnostic_information(*c.exception);
+}
+
+typedef
+boost::error_info<struct tag_cause, cause> cause_info;
+
+template <class E>
+struct nested_error : public E, public std::nested_exception
+{
+	explicit nested_error(const E& e) : E(e) {}
+};
+
+template <class E>
+auto nest(const E& outer, const boost::exception& inner)
+{
+	return boost::enable_error_info(nested_error<E>(outer)) <<
+		cause_info(cause{std::current_exception(), &inner});
+}
+
+const boost::exception* next_cause(const boost::exception& e)
+{
+	if (const cause* c = boost::get_error_info<cause_info>(e))
+		return c->exception;
+
+	if (const std::nested_exception* n = dynamic_cast<const std::nested_exception*>(&e))
+	{
+		if (n->nested_ptr())
+		{
+			try
+			{
+				n->rethrow_nested();
+			}
+			catch(const boost::exception& inner)
+			{
+				return &inner;
+			}
+			catch(...)
+			{
+			}
+		}
+	}
+	return nullptr;
+}
+
+template <class F>
+void for_each_cause(const boost::exception& e, F f)
+{
+	for (const boost::exception* level = &e; level; level = next_cause(*level))
+		f(*level);
+}
+
+void for_each_nested(const std::exception& e, int& levels)
+{
+	++levels;
+	try
+	{
+		std::rethrow_if_nested(e);
+	}
+	catch(const std::exception& inner)
+	{
+		for_each_nested(inner, levels);
+	}
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+char* call_through_layers(int layer)
+{
+	if (layer == 0)
+		return write_lots_of_zeros();
+
+	try
+	{
+		return call_through_layers(layer - 1);
+	}
+	catch(boost::exception& e)
+	{
+		BOOST_THROW_EXCEPTION(nest(layer_failed{}, e) << layer_info(layer));
+	}
+}
+
+template <class F>
+double nanoseconds_per_walk(F f)
+{
+	const int iterations = 10000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		f();
+	std::chrono::duration<double, std::nano> elapsed =
+		std::chrono::steady_clock::now() - start;
+	return elapsed.count() / iterations;
+}
+
+int main()
+{
+	try
+	{
+		char* c = call_through_layers(20);
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		int levels = 0;
+		for_each_cause(e, [&levels](const boost::exception&){ ++levels; });
+		std::cout << levels << " levels\n";
+
+		std::cout << "for_each_cause:  " << nanoseconds_per_walk([&e]{
+				int n = 0;
+				for_each_cause(e, [&n](const boost::exception&){ ++n; });
+				return n;
+			}) << " ns\n"
+			<< "rethrow_if_nested: " << nanoseconds_per_walk([&e]{
+				int n = 0;
+				for_each_nested(dynamic_cast<const std::exception&>(e), n);
+				return n;
+			}) << " ns\n";
+	}
+
+	try
+	{
+		char* c = call_through_layers(1);
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+		for_each_cause(e, [](const boost::exception& level){
+			if (const std::string* msg = boost::get_error_info<errmsg_info>(level))
+				std::cerr << "innermost message: " << *msg << '\n';
+		});
+	}
+}
+
+/*
+ * Boost.Exception has no support for std::nested_exception, and
+ * boost::errinfo_nested_exception stores the cause as a boost::exception_ptr,
+ * whose exception can only be reached by rethrowing it. A handler that wants to
+ * look at every cause of a deeply nested exception pays for one throw and one
+ * catch per level.
+ *
+ * The above example nests exceptions with nest(). It is called in a catch handler
+ * with the new exception and the caught one, and returns the new exception wrapped
+ * in nested_error, which also derives from std::nested_exception. The
+ * constructor of std::nested_exception stores std::current_exception(), so
+ * std::rethrow_if_nested() and std::nested_exception::rethrow_nested() work with
+ * these exceptions as with those from std::throw_with_nested(). In addition, nest()
+ * attaches cause_info. Its value holds a std::exception_ptr, which keeps the cause
+ * alive, and a pointer to the cause as a boost::exception.
+ *
+ * for_each_cause() calls f for the exception and then for every cause. It follows
+ * the pointers in cause_info in a loop and doesn't rethrow anything. Only
+ * exceptions that were nested by other code, for example with
+ * std::throw_with_nested(), have no cause_info. For them, next_cause() rethrows
+ * the nested exception once to find it. Causes that aren't derived from
+ * boost::exception end the chain.
+ *
+ * The pointer in cause_info relies on std::current_exception() referring to the
+ * exception object itself rather than a copy. The standard leaves this open, but
+ * GCC and Clang with the Itanium C++ ABI don't copy. The std::exception_ptr owns
+ * the object, so the pointer is valid as long as the outer exception exists.
+ *
+ * call_through_layers() nests the failure of write_lots_of_zeros() once per layer.
+ * main() builds a chain of 21 exceptions and measures how long it takes to visit
+ * all of them with for_each_cause() and with a recursive walk based on
+ * std::rethrow_if_nested(). Then it prints a chain of two exceptions. to_string()
+ * for cause makes boost::diagnostic_information() include the causes. Finally,
+ * for_each_cause() finds errmsg_info in the innermost exception.
+ *
+ */
@@ -0,0 +1,237 @@
+// Annotating exceptions during unwinding without catch and rethrow
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <type_traits>
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_frame, int> frame_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+struct pending_annotation
+{
+	int depth;
+	std::function<void(const boost::exception&)> annotate;
+};
+
+std::vector<pending_annotation>& pending_annotations()
+{
+	thread_local std::vector<pending_annotation> pending;
+	return pending;
+}
+
+void discard_annotations()
+{
+	pending_annotations().clear();
+}
+
+template <class ErrorInfo>
+class annotate_on_unwind
+{
+	typedef typename ErrorInfo::value_type value_type;
+	struct scalar_rvalue {};
+
+public:
+	explicit annotate_on_unwind(const value_type& value)
+		: value_(value), uncaught_(std::uncaught_exceptions())
+	{
+		if (uncaught_ == 0 && !std::current_exception())
+			discard_annotations();
+	}
+
+	annotate_on_unwind(typename std::conditional<std::is_scalar<value_type>::value,
+		scalar_rvalue, value_type&&>::type) = delete;
+	annotate_on_unwind(const annotate_on_unwind&) = delete;
+	annotate_on_unwind& operator=(const annotate_on_unwind&) = delete;
+
+	~annotate_on_unwind()
+	{
+		int depth = std::uncaught_exceptions();
+		if (depth > uncaught_)
+		{
+			try
+			{
+				value_type value = value_;
+				pending_annotations().push_back({depth,
+					[value](const boost::exception& e){ e << ErrorInfo(value); }});
+			}
+			catch(...)
+			{
+			}
+		}
+	}
+
+private:
+	typename std::conditional<std::is_scalar<value_type>::value,
+		value_type, const value_type&>::type value_;
+	int uncaught_;
+};
+
+void attach_annotations(const boost::exception& e)
+{
+	int depth = std::uncaught_exceptions() + 1;
+	std::vector<pending_annotation>& pending = pending_annotations();
+	std::size_t kept = 0;
+	for (pending_annotation& p : pending)
+	{
+		if (p.depth == depth)
+			p.annotate(e);
+		else if (p.depth < depth)
+			pending[kept++] = std::move(p);
+	}
+	pending.resize(kept);
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	static const std::string errmsg = "writing lots of zeros failed";
+	annotate_on_unwind<errmsg_info> context(errmsg);
+
+	char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+	std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+	return c;
+}
+
+char* call_with_guards(int frame)
+{
+	annotate_on_unwind<frame_info> context(frame);
+	if (frame == 0)
+		return write_lots_of_zeros();
+	return call_with_guards(frame - 1);
+}
+
+char* call_with_rethrow(int frame)
+{
+	try
+	{
+		if (frame == 0)
+			return write_lots_of_zeros();
+		return call_with_rethrow(frame - 1);
+	}
+	catch(boost::exception& e)
+	{
+		e << frame_info(frame);
+		throw;
+	}
+}
+
+template <class F>
+double microseconds_per_failure(F f)
+{
+	const int iterations = 10000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+	{
+		try
+		{
+			delete[] f();
+		}
+		catch(boost::exception& e)
+		{
+			attach_annotations(e);
+		}
+	}
+	std::chrono::duration<double, std::micro> elapsed =
+		std::chrono::steady_clock::now() - start;
+	return elapsed.count() / iterations;
+}
+
+int main()
+{
+	std::cout << "guards:          "
+		<< microseconds_per_failure([]{ return call_with_guards(19); }) << " us\n"
+		<< "catch/rethrow:   "
+		<< microseconds_per_failure([]{ return call_with_rethrow(19); }) << " us\n";
+
+	try
+	{
+		char* c = call_with_guards(19);
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		attach_annotations(e);
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * write_lots_of_zeros() in Example 56.1 catches the exception only to add
+ * errmsg_info and rethrows it right away. Every rethrow starts the two-phase
+ * unwinding of the C++ runtime from the beginning: the search for the next handler
+ * and the cleanup of all frames up to it. If many frames on the way up do the
+ * same, the cost grows with every one of them.
+ *
+ * The above example replaces the handlers with annotate_on_unwind. The object
+ * keeps a reference to, or a copy of, the value it should attach and the number
+ * returned by std::uncaught_exceptions() when it was created. On the normal path,
+ * the constructor also clears stale annotations, as described below, and the
+ * destructor only compares the number. If it is higher when the object is
+ * destroyed, the frame is being left because of an exception. Only then does the
+ * destructor copy the value and queue an annotation. No handler is entered, so
+ * unwinding continues without interruption.
+ *
+ * A destructor has no access to the exception in flight: std::current_exception()
+ * only returns it once it has been caught. The annotations are therefore kept in
+ * a thread_local list, in the order the frames were left, and the handler that
+ * finally catches the exception applies them with attach_annotations(). Outer
+ * frames come later, so for the same error_info type, the outermost value wins, as
+ * it does with catch and rethrow. If queueing fails because no memory is left, the
+ * annotation is lost, because a destructor called during unwinding must not throw.
+ *
+ * Nothing ties a queued annotation to one particular exception, so the list must
+ * not outlive the exception it was made for. Every entry records the value of
+ * std::uncaught_exceptions() when it was queued. Inside the handler, this value is
+ * one lower, so attach_annotations() applies only entries with exactly that depth.
+ * It keeps entries of lower depth, which belong to an outer exception that is
+ * still in flight because the handler runs in a destructor, and drops deeper ones,
+ * which are left over from exceptions that were caught elsewhere. A guard created
+ * while no exception is in flight and none is being handled clears the list as
+ * well, since any entries in it are stale. Inside a catch handler,
+ * std::uncaught_exceptions() is 0 too, but std::current_exception() returns the
+ * caught exception, whose annotations may not have been attached yet, so guards
+ * created there keep the list. This doesn't cover a handler that swallows an
+ * annotated exception when the next exception is thrown before any guard is
+ * created outside a handler. Such a handler must call attach_annotations() or
+ * discard_annotations().
+ *
+ * Scalar values such as the int of frame_info are copied into the guard, which
+ * costs nothing. For other types annotate_on_unwind only keeps a reference, so the
+ * value must live at least as long as the guard. For these types the constructor
+ * taking an rvalue is deleted, which rejects temporaries such as a string literal
+ * converted to std::string. That's why write_lots_of_zeros() uses a static
+ * std::string for its message.
+ *
+ * main() throws through 20 frames that each attach their number as frame_info,
+ * once with annotate_on_unwind and once with catch and rethrow, and prints the
+ * time per failure. Then it prints the exception annotated by the guards.
+ *
+ */
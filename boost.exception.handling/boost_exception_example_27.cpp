@@ -0,0 +1,209 @@
+// Returning errors instead of throwing them, and throwing them where needed
+//
+#include <boost/exception/all.hpp>
+#include <boost/assert.hpp>
+#include <boost/assert/source_location.hpp>
+#include <boost/throw_exception.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <variant>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_requested_size, std::size_t> requested_size_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+struct error
+{
+	const char* errmsg;
+	std::size_t size;
+	boost::source_location location;
+};
+
+[[noreturn]] void throw_error(const error& e)
+{
+	auto x = boost::enable_error_info(allocation_failed{}) << requested_size_info(e.size);
+	if (e.errmsg)
+		x << errmsg_info(e.errmsg);
+	boost::throw_exception(x, e.location);
+}
+
+template <class T, class E>
+class result
+{
+public:
+	result(T value) : v_(std::in_place_index<0>, std::move(value)) {}
+	result(E error) : v_(std::in_place_index<1>, std::move(error)) {}
+
+	explicit operator bool() const noexcept
+	{
+		return v_.index() == 0;
+	}
+
+	T& value() noexcept
+	{
+		BOOST_ASSERT(*this);
+		return *std::get_if<0>(&v_);
+	}
+
+	E& error() noexcept
+	{
+		BOOST_ASSERT(!*this);
+		return *std::get_if<1>(&v_);
+	}
+
+	T value_or_throw()
+	{
+		if (!*this)
+			throw_error(error());
+		return std::move(value());
+	}
+
+private:
+	std::variant<T, E> v_;
+};
+
+result<char*, error> try_allocate_memory(std::size_t size) noexcept
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		return error{nullptr, size, BOOST_CURRENT_LOCATION};
+
+	return c;
+}
+
+result<char*, error> try_write_lots_of_zeros() noexcept
+{
+	result<char*, error> r = try_allocate_memory(std::numeric_limits<std::size_t>::max());
+	if (!r)
+	{
+		r.error().errmsg = "writing lots of zeros failed";
+		return r;
+	}
+
+	std::fill_n(r.value(), std::numeric_limits<std::size_t>::max(), 0);
+	return r;
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+			requested_size_info(size));
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+template <class F>
+double nanoseconds_per_failure(F f)
+{
+	const int iterations = 100000;
+	std::size_t failures = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; ++i)
+		failures += f();
+	std::chrono::duration<double, std::nano> elapsed =
+		std::chrono::steady_clock::now() - start;
+	if (failures != iterations)
+	{
+		std::cerr << "\nbenchmark invalid: not every call failed\n";
+		std::exit(EXIT_FAILURE);
+	}
+	return elapsed.count() / iterations;
+}
+
+int main()
+{
+	std::cout << "result:    " << nanoseconds_per_failure([]{
+			result<char*, error> r = try_write_lots_of_zeros();
+			if (r)
+				delete[] r.value();
+			return !r;
+		}) << " ns\n"
+		<< "exception: " << nanoseconds_per_failure([]{
+			try
+			{
+				delete[] write_lots_of_zeros();
+				return false;
+			}
+			catch(boost::exception&)
+			{
+				return true;
+			}
+		}) << " ns\n";
+
+	try
+	{
+		char* c = try_write_lots_of_zeros().value_or_throw();
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * Throwing an exception costs far more than returning from a function. The
+ * runtime allocates the exception object, searches the stack for a handler and
+ * unwinds every frame on the way. For a failure that happens rarely, this doesn't
+ * matter. On a path where allocation failures are routine, it does.
+ *
+ * The above example adds try_allocate_memory() and try_write_lots_of_zeros(),
+ * which never throw. They return result<char*, error>, which holds either the
+ * pointer or an error. error carries the same information as the exception:
+ * an error message, the requested size and the location where the failure was
+ * detected. The location is a boost::source_location created with the macro
+ * BOOST_CURRENT_LOCATION, which is what BOOST_THROW_EXCEPTION uses internally as
+ * well. The error message is a pointer to a string literal, so neither creating
+ * nor passing on an error allocates memory. try_write_lots_of_zeros() adds its
+ * message the way write_lots_of_zeros() adds errmsg_info.
+ *
+ * value() and error() may only be called for the alternative the result holds,
+ * which they check with BOOST_ASSERT. At the boundary where exceptions are
+ * wanted, value_or_throw() returns the pointer or throws. throw_error() turns the
+ * error into allocation_failed with requested_size_info and errmsg_info, and
+ * passes the location to boost::throw_exception(), which stores it as
+ * boost::throw_file, boost::throw_line and boost::throw_function. The output of
+ * boost::diagnostic_information() is the same as if the exception had been thrown
+ * by allocate_memory().
+ *
+ * main() measures the failure path of both variants, once with result and once
+ * with the exception thrown by allocate_memory() and rethrown by
+ * write_lots_of_zeros(), and then converts a failed result into an exception.
+ * Both times include the failed call to new, which is the same for both variants.
+ *
+ */
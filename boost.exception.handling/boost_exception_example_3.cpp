@@ -62,13 +62,15 @@ int main()
  * boost::get_error_info() to directly access the error message of type
  * errmsg_info.
  *
- * Because boost::get_error_info() returns a smart pointer of type boost::shared_ptr,
- * operator* is used to fetch the error message. If the parameter passed to
- * boost::get_error_info() is not of type boost::exception, a null pointer is
- * returned. 
+ * Because boost::get_error_info() returns a plain pointer to the value stored
+ * in the exception, operator* is used to fetch the error message. Very old
+ * versions of Boost returned a smart pointer of type boost::shared_ptr instead.
+ * The pointer stays valid as long as the exception object exists. If the
+ * parameter passed to boost::get_error_info() is not of type boost::exception,
+ * a null pointer is returned. 
  *
  * If the macro BOOST_THROW_EXCEPTION is always used to throw an exception,
  * the exception will always be derived from boost::exception - there is no 
- * need to check the returned smart pointer for null in that case.
+ * need to check the returned pointer for null in that case.
  *
  */
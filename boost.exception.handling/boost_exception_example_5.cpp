@@ -0,0 +1,247 @@
+// Size-class slabs with per-thread caches behind allocate_memory()
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <iostream>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_size_class, std::size_t> size_class_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+const std::size_t min_class_size = 16;
+const std::size_t size_class_count = 9;
+const std::size_t max_class_size = min_class_size << (size_class_count - 1);
+const std::size_t slab_size = 64 * 1024;
+const std::size_t batch_size = 32;
+
+struct free_block
+{
+	free_block* next;
+};
+
+std::size_t size_class(std::size_t size)
+{
+	std::size_t index = 0;
+	while ((min_class_size << index) < size)
+		++index;
+	return index;
+}
+
+class depot
+{
+public:
+	free_block* take(std::size_t index, std::size_t& count)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!lists_[index] && !carve(index))
+			return nullptr;
+
+		free_block* first = lists_[index];
+		free_block* last = first;
+		count = 1;
+		while (count < batch_size && last->next)
+		{
+			last = last->next;
+			++count;
+		}
+		lists_[index] = last->next;
+		last->next = nullptr;
+		return first;
+	}
+
+	void give(std::size_t index, free_block* first, free_block* last)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		last->next = lists_[index];
+		lists_[index] = first;
+	}
+
+private:
+	bool carve(std::size_t index)
+	{
+		char* slab = new(std::nothrow) char[slab_size];
+		if (!slab)
+			return false;
+
+		std::size_t block = min_class_size << index;
+		for (std::size_t offset = 0; offset + block <= slab_size; offset += block)
+		{
+			free_block* b = reinterpret_cast<free_block*>(slab + offset);
+			b->next = lists_[index];
+			lists_[index] = b;
+		}
+		return true;
+	}
+
+	std::mutex mutex_;
+	free_block* lists_[size_class_count] = {};
+};
+
+depot central_depot;
+
+struct thread_cache
+{
+	free_block* lists[size_class_count] = {};
+	std::size_t counts[size_class_count] = {};
+
+	~thread_cache()
+	{
+		for (std::size_t i = 0; i < size_class_count; ++i)
+			flush(i, counts[i]);
+	}
+
+	void flush(std::size_t index, std::size_t n)
+	{
+		if (n == 0)
+			return;
+
+		free_block* first = lists[index];
+		free_block* last = first;
+		for (std::size_t i = 1; i < n; ++i)
+			last = last->next;
+		lists[index] = last->next;
+		counts[index] -= n;
+		central_depot.give(index, first, last);
+	}
+};
+
+thread_local thread_cache cache;
+
+char* allocate_memory(std::size_t size)
+{
+	if (size > max_class_size)
+	{
+		char* c = new(std::nothrow) char[size];
+		if (!c)
+			BOOST_THROW_EXCEPTION(allocation_failed{});
+
+		return c;
+	}
+
+	std::size_t index = size_class(size);
+	if (!cache.lists[index])
+	{
+		cache.lists[index] = central_depot.take(index, cache.counts[index]);
+		if (!cache.lists[index])
+			BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+				size_class_info(min_class_size << index));
+	}
+
+	free_block* b = cache.lists[index];
+	cache.lists[index] = b->next;
+	--cache.counts[index];
+	return reinterpret_cast<char*>(b);
+}
+
+void free_memory(char* c, std::size_t size)
+{
+	if (size > max_class_size)
+	{
+		delete[] c;
+		return;
+	}
+
+	std::size_t index = size_class(size);
+	free_block* b = reinterpret_cast<free_block*>(c);
+	b->next = cache.lists[index];
+	cache.lists[index] = b;
+	if (++cache.counts[index] > 2 * batch_size)
+		cache.flush(index, batch_size);
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		std::fill_n(c, std::numeric_limits<std::size_t>::max(), 0);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+void worker(std::size_t seed)
+{
+	std::vector<char*> blocks;
+	for (std::size_t round = 0; round < 1000; ++round)
+	{
+		for (std::size_t i = 0; i < 100; ++i)
+		{
+			std::size_t size = 1 + (seed * 131 + i * 17) % max_class_size;
+			blocks.push_back(allocate_memory(size));
+			std::fill_n(blocks.back(), size, 0);
+			free_memory(blocks.back(), size);
+			blocks.pop_back();
+		}
+	}
+}
+
+int main()
+{
+	std::vector<std::thread> threads;
+	for (std::size_t i = 0; i < 4; ++i)
+		threads.emplace_back(worker, i);
+	for (std::thread& t : threads)
+		t.join();
+
+	try
+	{
+		char* c = write_lots_of_zeros();
+		free_memory(c, std::numeric_limits<std::size_t>::max());
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * When many threads call allocate_memory() at the same time, they all compete for
+ * the global heap. The above example puts a slab allocator in front of new.
+ *
+ * Requests up to max_class_size bytes are rounded up to a power of two, a so called
+ * size class. Each thread keeps one free list per size class in the thread_local
+ * object cache, so the common case of allocate_memory() and free_memory() doesn't
+ * take a lock at all.
+ *
+ * If a thread's free list is empty, it takes a batch of blocks from central_depot.
+ * If a thread frees more blocks than it needs, it returns a batch to the depot, where
+ * other threads can pick them up. Only the depot is protected by a mutex, and it is
+ * visited once per batch rather than once per allocation. When the depot runs dry
+ * it carves a new slab of slab_size bytes into blocks of the requested class.
+ *
+ * Requests larger than max_class_size fall back to new(std::nothrow) as before. This
+ * is what happens in write_lots_of_zeros(), so the output of main() looks like the
+ * one of Example 56.2.
+ *
+ * If carving a new slab fails, allocate_memory() throws allocation_failed with an
+ * error_info of type size_class_info attached. It contains the block size of the
+ * class that ran out, which is usually more useful than the size originally
+ * requested.
+ *
+ * Slabs are never returned to the heap in this example. Memory freed by one size
+ * class can't be reused by another.
+ *
+ */
@@ -0,0 +1,135 @@
+// Backing large allocations with huge pages
+//
+#include <boost/exception/all.hpp>
+#include <boost/exception/errinfo_errno.hpp>
+#include <exception>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <iostream>
+#include <sys/mman.h>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_backing, std::string> backing_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+const std::size_t huge_page_size = 2 * 1024 * 1024;
+
+struct large_block
+{
+	char* data;
+	std::size_t size;
+	std::string backing;
+};
+
+large_block allocate_memory(std::size_t size)
+{
+	std::string backing;
+	if (size > std::numeric_limits<std::size_t>::max() - (huge_page_size - 1))
+		BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+			backing_info("none: size can't be rounded to huge pages"));
+
+	std::size_t rounded = (size + huge_page_size - 1) & ~(huge_page_size - 1);
+
+#ifdef MAP_HUGETLB
+	void* p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if (p != MAP_FAILED)
+		return large_block{static_cast<char*>(p), rounded, "MAP_HUGETLB"};
+	backing = "MAP_HUGETLB failed, ";
+#endif
+
+	void* q = mmap(nullptr, rounded, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (q == MAP_FAILED)
+	{
+		int err = errno;
+		BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+			backing_info(backing + "4 KiB pages failed") <<
+			boost::errinfo_errno(err));
+	}
+
+#ifdef MADV_HUGEPAGE
+	if (madvise(q, rounded, MADV_HUGEPAGE) == 0)
+		return large_block{static_cast<char*>(q), rounded,
+			backing + "transparent huge pages"};
+	backing += "MADV_HUGEPAGE failed, ";
+#endif
+
+	return large_block{static_cast<char*>(q), rounded, backing + "4 KiB pages"};
+}
+
+void free_memory(const large_block& b)
+{
+	munmap(b.data, b.size);
+}
+
+large_block write_lots_of_zeros(std::size_t size)
+{
+	try
+	{
+		large_block b = allocate_memory(size);
+		std::fill_n(b.data, size, 0);
+
+		return b;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+int main()
+{
+	try
+	{
+		large_block b = write_lots_of_zeros(64 * 1024 * 1024);
+		std::cout << "64 MiB backed by " << b.backing << '\n';
+		free_memory(b);
+
+		b = write_lots_of_zeros(std::numeric_limits<std::size_t>::max() / 2);
+		free_memory(b);
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * Memory for very large buffers is better obtained from the operating system
+ * directly than from new. On Linux, mmap() can back a mapping with 2 MiB huge pages
+ * instead of 4 KiB pages, so far fewer TLB entries are needed to cover the buffer.
+ *
+ * allocate_memory() first rounds the requested size up to a multiple of the huge
+ * page size. It then tries the following, in order:
+ *
+ * 1. mmap() with MAP_HUGETLB. This only succeeds if the administrator has reserved
+ *    huge pages, for example via /proc/sys/vm/nr_hugepages.
+ * 2. An ordinary anonymous mapping followed by madvise() with MADV_HUGEPAGE, which
+ *    asks the kernel to use transparent huge pages where it can.
+ * 3. The ordinary mapping alone, if madvise() is refused.
+ *
+ * The steps that were tried are collected in a string. On success it is returned
+ * as part of large_block, so the caller can log which backing was used. If the
+ * last mapping fails too, the string is attached to allocation_failed as
+ * backing_info together with boost::errinfo_errno. boost::errinfo_errno is one of
+ * the predefined error_info types of Boost.Exception. diagnostic_information()
+ * prints it with the text from strerror().
+ *
+ * Because the function returns large_block instead of char*, free_memory() must be
+ * used instead of delete[].
+ *
+ */
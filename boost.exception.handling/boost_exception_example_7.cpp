@@ -0,0 +1,210 @@
+// NUMA placement for allocate_memory() and write_lots_of_zeros()
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <iostream>
+#include <numa.h>
+#include <sched.h>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+typedef
+boost::error_info<struct tag_numa_policy, std::string> numa_policy_info;
+typedef
+boost::error_info<struct tag_numa_node, int> numa_node_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+enum class numa_policy { local, interleave, bind };
+
+const char* to_string(numa_policy policy)
+{
+	switch (policy)
+	{
+	case numa_policy::local: return "local";
+	case numa_policy::interleave: return "interleave";
+	case numa_policy::bind: return "bind";
+	}
+	return "unknown";
+}
+
+int current_node()
+{
+	int node = numa_node_of_cpu(sched_getcpu());
+	return node < 0 ? 0 : node;
+}
+
+char* allocate_memory(std::size_t size, numa_policy policy, int node)
+{
+	void* c = nullptr;
+	switch (policy)
+	{
+	case numa_policy::local:
+		c = numa_alloc_local(size);
+		break;
+	case numa_policy::interleave:
+		c = numa_alloc_interleaved(size);
+		break;
+	case numa_policy::bind:
+		c = numa_alloc_onnode(size, node);
+		break;
+	}
+
+	if (!c)
+		BOOST_THROW_EXCEPTION(boost::enable_error_info(allocation_failed{}) <<
+			numa_policy_info(to_string(policy)) <<
+			numa_node_info(node));
+
+	return static_cast<char*>(c);
+}
+
+std::size_t cpus_of_node(int node)
+{
+	bitmask* cpus = numa_allocate_cpumask();
+	std::size_t count = 0;
+	if (numa_node_to_cpus(node, cpus) == 0)
+		count = numa_bitmask_weight(cpus);
+	numa_free_cpumask(cpus);
+	return count;
+}
+
+void fill_on_node(char* c, std::size_t size, int node)
+{
+	std::size_t cpus = cpus_of_node(node);
+	std::size_t count = std::max<std::size_t>(1, cpus);
+	std::size_t chunk = (size + count - 1) / count;
+
+	std::vector<std::thread> threads;
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		std::size_t begin = std::min(size, i * chunk);
+		std::size_t n = std::min(size - begin, chunk);
+		threads.emplace_back([=] {
+			if (cpus)
+				numa_run_on_node(node);
+			std::fill_n(c + begin, n, 0);
+		});
+	}
+	for (std::thread& t : threads)
+		t.join();
+}
+
+char* write_lots_of_zeros(std::size_t size, numa_policy policy, int node)
+{
+	try
+	{
+		if (policy == numa_policy::local)
+			node = current_node();
+
+		char* c = allocate_memory(size, policy, node);
+		fill_on_node(c, size, node);
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+void compare_nodes()
+{
+	const std::size_t size = 256 * 1024 * 1024;
+	int max_node = numa_max_node();
+
+	for (int memory = 0; memory <= max_node; ++memory)
+	{
+		if (!numa_bitmask_isbitset(numa_all_nodes_ptr, memory))
+			continue;
+
+		char* c = allocate_memory(size, numa_policy::bind, memory);
+		fill_on_node(c, size, memory);
+
+		for (int cpu = 0; cpu <= max_node; ++cpu)
+		{
+			if (cpus_of_node(cpu) == 0)
+				continue;
+
+			auto start = std::chrono::steady_clock::now();
+			fill_on_node(c, size, cpu);
+			std::chrono::duration<double> elapsed =
+				std::chrono::steady_clock::now() - start;
+			std::cout << "memory on node " << memory << ", threads on node " << cpu
+				<< ": " << size / elapsed.count() / 1e9 << " GB/s\n";
+		}
+		numa_free(c, size);
+	}
+}
+
+int main()
+{
+	if (numa_available() < 0)
+	{
+		std::cerr << "NUMA is not supported on this system\n";
+		return 1;
+	}
+
+	try
+	{
+		compare_nodes();
+
+		char* c = write_lots_of_zeros(std::numeric_limits<std::size_t>::max(),
+			numa_policy::bind, 0);
+		numa_free(c, std::numeric_limits<std::size_t>::max());
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * On a machine with several NUMA nodes, a page is placed on the node of the thread
+ * that touches it first. If allocate_memory() is called on one socket and
+ * write_lots_of_zeros() runs on another, every later access to the buffer crosses
+ * the interconnect.
+ *
+ * The above example uses libnuma and must be linked with -lnuma. allocate_memory()
+ * takes a numa_policy and a node:
+ *
+ * - numa_policy::local places memory on the node of the calling thread.
+ * - numa_policy::interleave spreads the pages round-robin over all nodes.
+ * - numa_policy::bind places memory on the given node.
+ *
+ * fill_on_node() writes the zeros with one thread per CPU of the node, as reported
+ * by numa_node_to_cpus(). Each thread calls numa_run_on_node() before it touches
+ * its part of the buffer, so the first touch happens on the node the memory is
+ * meant for. Some nodes, such as those for attached memory devices, have memory
+ * but no CPUs. For them a single thread does the work wherever it runs, which is
+ * fine because bound memory is placed on the node regardless of who touches it.
+ *
+ * If the allocation fails, allocation_failed carries two error_info values: the
+ * policy as numa_policy_info and the node as numa_node_info. For the local policy,
+ * the node is the one write_lots_of_zeros() was running on.
+ *
+ * compare_nodes() binds a 256 MiB buffer to each node in turn and measures the
+ * bandwidth of filling it from every node. Node numbers don't have to be
+ * consecutive, and not every node has both memory and CPUs, so compare_nodes()
+ * doesn't count from 0 to numa_num_configured_nodes(). Memory is bound to the
+ * nodes in numa_all_nodes_ptr, the nodes the process may allocate on, and the
+ * threads run on every node up to numa_max_node() that has CPUs. The diagonal
+ * shows local bandwidth, the other entries remote bandwidth. On a machine with a
+ * single node only one line is printed. Booting a Linux kernel with numa=fake=2
+ * splits the memory into two emulated nodes, which is enough to exercise the code
+ * paths, although both nodes then have the same bandwidth.
+ *
+ */
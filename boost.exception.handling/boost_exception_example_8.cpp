@@ -0,0 +1,229 @@
+// A zero-fill kernel selected at run time
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <immintrin.h>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+typedef void (*zero_fill_function)(char*, std::size_t);
+
+std::size_t zero_head(char*& c, std::size_t n, std::size_t alignment)
+{
+	std::size_t head = (alignment - reinterpret_cast<std::uintptr_t>(c) % alignment)
+		% alignment;
+	head = std::min(head, n);
+	for (std::size_t i = 0; i < head; ++i)
+		*c++ = 0;
+	return n - head;
+}
+
+void zero_tail(char* c, std::size_t n)
+{
+	for (std::size_t i = 0; i < n; ++i)
+		c[i] = 0;
+}
+
+void zero_fill_generic(char* c, std::size_t n)
+{
+	std::fill_n(c, n, 0);
+}
+
+__attribute__((target("sse2")))
+void zero_fill_sse2(char* c, std::size_t n)
+{
+	n = zero_head(c, n, 16);
+	__m128i zero = _mm_setzero_si128();
+	for (; n >= 64; n -= 64, c += 64)
+	{
+		_mm_store_si128(reinterpret_cast<__m128i*>(c), zero);
+		_mm_store_si128(reinterpret_cast<__m128i*>(c + 16), zero);
+		_mm_store_si128(reinterpret_cast<__m128i*>(c + 32), zero);
+		_mm_store_si128(reinterpret_cast<__m128i*>(c + 48), zero);
+	}
+	for (; n >= 16; n -= 16, c += 16)
+		_mm_store_si128(reinterpret_cast<__m128i*>(c), zero);
+	zero_tail(c, n);
+}
+
+__attribute__((target("avx2")))
+void zero_fill_avx2(char* c, std::size_t n)
+{
+	n = zero_head(c, n, 32);
+	__m256i zero = _mm256_setzero_si256();
+	for (; n >= 128; n -= 128, c += 128)
+	{
+		_mm256_store_si256(reinterpret_cast<__m256i*>(c), zero);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(c + 32), zero);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(c + 64), zero);
+		_mm256_store_si256(reinterpret_cast<__m256i*>(c + 96), zero);
+	}
+	for (; n >= 32; n -= 32, c += 32)
+		_mm256_store_si256(reinterpret_cast<__m256i*>(c), zero);
+	zero_tail(c, n);
+}
+
+__attribute__((target("avx512f")))
+void zero_fill_avx512(char* c, std::size_t n)
+{
+	n = zero_head(c, n, 64);
+	__m512i zero = _mm512_setzero_si512();
+	for (; n >= 256; n -= 256, c += 256)
+	{
+		_mm512_store_si512(c, zero);
+		_mm512_store_si512(c + 64, zero);
+		_mm512_store_si512(c + 128, zero);
+		_mm512_store_si512(c + 192, zero);
+	}
+	for (; n >= 64; n -= 64, c += 64)
+		_mm512_store_si512(c, zero);
+	zero_tail(c, n);
+}
+
+zero_fill_function select_zero_fill()
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return zero_fill_avx512;
+	if (__builtin_cpu_supports("avx2"))
+		return zero_fill_avx2;
+	if (__builtin_cpu_supports("sse2"))
+		return zero_fill_sse2;
+	return zero_fill_generic;
+}
+
+const zero_fill_function zero_fill = select_zero_fill();
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		zero_fill(c, std::numeric_limits<std::size_t>::max());
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+void compare_kernels()
+{
+	struct kernel
+	{
+		const char* name;
+		bool supported;
+		zero_fill_function fill;
+	};
+	const kernel kernels[] = {
+		{ "std::fill_n", true, zero_fill_generic },
+		{ "SSE2", __builtin_cpu_supports("sse2") != 0, zero_fill_sse2 },
+		{ "AVX2", __builtin_cpu_supports("avx2") != 0, zero_fill_avx2 },
+		{ "AVX-512", __builtin_cpu_supports("avx512f") != 0, zero_fill_avx512 },
+	};
+	const std::size_t bytes_per_measurement = std::size_t(256) << 20;
+
+	for (std::size_t size = 64; size <= (std::size_t(16) << 30); size *= 16)
+	{
+		char* c;
+		try
+		{
+			c = allocate_memory(size);
+		}
+		catch(allocation_failed&)
+		{
+			std::cout << size << " bytes: skipped, allocation failed\n";
+			continue;
+		}
+
+		std::size_t passes = std::max<std::size_t>(1, bytes_per_measurement / size);
+		for (const kernel& k : kernels)
+		{
+			if (!k.supported)
+				continue;
+
+			k.fill(c, size);
+			auto start = std::chrono::steady_clock::now();
+			for (std::size_t i = 0; i < passes; ++i)
+			{
+				k.fill(c, size);
+				asm volatile("" : : "r"(c) : "memory");
+			}
+			std::chrono::duration<double> elapsed =
+				std::chrono::steady_clock::now() - start;
+			std::cout << size << " bytes, " << k.name << ": "
+				<< passes * size / elapsed.count() / 1e9 << " GB/s\n";
+		}
+		delete[] c;
+	}
+}
+
+int main()
+{
+	compare_kernels();
+
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * write_lots_of_zeros() in the previous examples relies on the compiler to turn
+ * std::fill_n() into efficient code. The compiler may only use the instructions
+ * of the target it was told to generate code for, which for x86-64 is SSE2.
+ *
+ * The above example provides one zero-fill kernel per instruction set. Each kernel
+ * is compiled with __attribute__((target(...))), so the whole program doesn't need
+ * to be built with -mavx2 or -mavx512f. zero_head() writes single bytes until the
+ * pointer is aligned to the vector width, the main loop then uses aligned stores,
+ * and zero_tail() writes the remaining bytes.
+ *
+ * select_zero_fill() asks the CPU via cpuid, which __builtin_cpu_supports() wraps,
+ * which instruction sets are available. The result is stored once in the function
+ * pointer zero_fill, which write_lots_of_zeros() calls instead of std::fill_n().
+ *
+ * compare_kernels() measures every kernel the CPU supports for buffer sizes from
+ * 64 bytes to 16 GiB, growing by a factor of 16. Small buffers are filled many
+ * times so that every measurement writes at least 256 MiB. If a buffer can't be
+ * allocated, allocate_memory() throws allocation_failed, and that size is skipped.
+ * Catching allocation_failed works here because BOOST_THROW_EXCEPTION throws a type
+ * derived from it.
+ *
+ * These kernels are GCC and Clang specific.
+ *
+ */
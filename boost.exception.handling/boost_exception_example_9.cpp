@@ -0,0 +1,208 @@
+// Streaming stores for very large zero fills
+//
+#include <boost/exception/all.hpp>
+#include <exception>
+#include <new>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <immintrin.h>
+#include <unistd.h>
+
+typedef
+boost::error_info<struct tag_errmsg, std::string> errmsg_info;
+
+struct allocation_failed : public std::exception
+{
+	const char* what() const noexcept
+	{
+		return "allocation failed";
+	}
+};
+
+std::size_t last_level_cache_size()
+{
+	long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	return size > 0 ? size : 32 * 1024 * 1024;
+}
+
+std::size_t streaming_threshold = last_level_cache_size();
+
+void zero_fill_temporal(char* c, std::size_t n)
+{
+	std::fill_n(c, n, 0);
+}
+
+__attribute__((target("sse2")))
+void zero_fill_streaming_sse2(char* c, std::size_t n)
+{
+	std::size_t head = (16 - reinterpret_cast<std::uintptr_t>(c) % 16) % 16;
+	head = std::min(head, n);
+	std::fill_n(c, head, 0);
+	c += head;
+	n -= head;
+
+	__m128i zero = _mm_setzero_si128();
+	for (; n >= 16; n -= 16, c += 16)
+		_mm_stream_si128(reinterpret_cast<__m128i*>(c), zero);
+	_mm_sfence();
+	std::fill_n(c, n, 0);
+}
+
+__attribute__((target("avx2")))
+void zero_fill_streaming_avx2(char* c, std::size_t n)
+{
+	std::size_t head = (32 - reinterpret_cast<std::uintptr_t>(c) % 32) % 32;
+	head = std::min(head, n);
+	std::fill_n(c, head, 0);
+	c += head;
+	n -= head;
+
+	__m256i zero = _mm256_setzero_si256();
+	for (; n >= 32; n -= 32, c += 32)
+		_mm256_stream_si256(reinterpret_cast<__m256i*>(c), zero);
+	_mm_sfence();
+	std::fill_n(c, n, 0);
+}
+
+void zero_fill_streaming(char* c, std::size_t n)
+{
+	static const bool avx2 = __builtin_cpu_supports("avx2");
+	if (avx2)
+		zero_fill_streaming_avx2(c, n);
+	else
+		zero_fill_streaming_sse2(c, n);
+}
+
+void zero_fill(char* c, std::size_t n)
+{
+	if (n >= streaming_threshold)
+		zero_fill_streaming(c, n);
+	else
+		zero_fill_temporal(c, n);
+}
+
+char* allocate_memory(std::size_t size)
+{
+	char* c = new(std::nothrow) char[size];
+	if (!c)
+		BOOST_THROW_EXCEPTION(allocation_failed{});
+
+	return c;
+}
+
+char* write_lots_of_zeros()
+{
+	try
+	{
+		char* c = allocate_memory(std::numeric_limits<std::size_t>::max());
+		zero_fill(c, std::numeric_limits<std::size_t>::max());
+
+		return c;
+	}
+	catch(boost::exception& e)
+	{
+		e << errmsg_info("writing lots of zeros failed");
+		throw;
+	}
+}
+
+double lookups_per_second(const std::vector<std::uint32_t>& table,
+	const std::vector<std::uint32_t>& keys)
+{
+	volatile std::uint32_t sink = 0;
+	auto start = std::chrono::steady_clock::now();
+	std::uint32_t sum = 0;
+	for (std::uint32_t key : keys)
+		sum += table[key];
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	sink = sum;
+	(void)sink;
+	return keys.size() / elapsed.count();
+}
+
+void compare_cache_pollution()
+{
+	const std::size_t table_size =
+		std::min<std::size_t>(last_level_cache_size() / 2, 8 * 1024 * 1024) /
+		sizeof(std::uint32_t);
+	const std::size_t buffer_size = 512 * 1024 * 1024;
+	std::vector<std::uint32_t> table(table_size, 1);
+	std::vector<std::uint32_t> keys(table_size / 16);
+	std::mt19937 random;
+	for (std::uint32_t& key : keys)
+		key = random() % table_size;
+	char* buffer = allocate_memory(buffer_size);
+
+	struct mode
+	{
+		const char* name;
+		void (*fill)(char*, std::size_t);
+	};
+	const mode modes[] = {
+		{ "no fill", nullptr },
+		{ "ordinary stores", zero_fill_temporal },
+		{ "streaming stores", zero_fill_streaming },
+	};
+
+	for (const mode& m : modes)
+	{
+		double rate = 0;
+		for (int round = 0; round < 10; ++round)
+		{
+			lookups_per_second(table, keys);
+			if (m.fill)
+				m.fill(buffer, buffer_size);
+			rate += lookups_per_second(table, keys) / 10;
+		}
+		std::cout << m.name << ": " << rate << " lookups/s\n";
+	}
+	delete[] buffer;
+}
+
+int main()
+{
+	compare_cache_pollution();
+
+	try
+	{
+		char* c = write_lots_of_zeros();
+		delete[] c;
+	}
+	catch(boost::exception& e)
+	{
+		std::cerr << boost::diagnostic_information(e);
+	}
+}
+
+/*
+ * Ordinary stores go through the cache. When write_lots_of_zeros() clears a buffer
+ * that is much larger than the last-level cache, the zeros evict everything else,
+ * although the buffer itself won't fit in the cache anyway.
+ *
+ * Non-temporal stores bypass the cache and are combined into full cache lines in
+ * write-combining buffers. _mm_stream_si128() compiles to movntdq and
+ * _mm256_stream_si256() to vmovntdq. Both require aligned addresses, which is why
+ * the unaligned head and tail are written with std::fill_n(). Non-temporal stores
+ * are weakly ordered, so _mm_sfence() is called before the function returns to make
+ * the zeros visible to other threads in program order.
+ *
+ * zero_fill() only streams if the buffer is at least streaming_threshold bytes
+ * large. The threshold defaults to the size of the last-level cache as reported by
+ * sysconf() and can be changed by the program. Smaller buffers are likely to be
+ * read soon and benefit from staying in the cache.
+ *
+ * compare_cache_pollution() models a lookup workload that shares the cache with
+ * the zero fill. A table of at most half the size of the last-level cache is read
+ * at random positions, about once per cache line, and the lookup rate is measured
+ * directly after a 512 MiB buffer has been cleared. With ordinary stores the table
+ * has been evicted and the rate drops. With streaming stores it should stay close
+ * to the rate measured without any fill.
+ *
+ */